@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "3dsx.h"
+#include "reader.h"
+#include "reader_posix.h"
+#include "pipeline_posix.h"
+
+#include "target.h"
+#include "../../compress/lz11_stream.h"
+
+// Load3DSXSegments in target.h's simulated address space. Each file is checked
+// against a plain reading of the 3DSX format, then loaded over and over for
+// relocations and bytes per second. Files prelinked for the map take the fast
+// path, which is checked the same way. --bandwidth and --latency make the
+// POSIX backend as slow as the SD card, to weigh the bytes _3DSX_FLAG_LZ11
+// files save against decoding them, or what --pipeline gains by relocating
+// while the segments after are read.
+
+#define READBUFSIZE 0x8000
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// a plain reading of the format, for the loader to agree with; the segments'
+// places are decided the same way, everything else is done separately
+static u8* refSeg[3];
+static u32 refAddr[3], refSize[3], refLoadable;
+
+static u32 word(const u8* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static int reference(const u8* file, u32 size, const memorymap_t* m, u32* numPatched)
+{
+	_3DSX_Header hdr;
+	u32 i, j;
+	if(size < sizeof(hdr)) return -1;
+	memcpy(&hdr, file, sizeof(hdr));
+	if(hdr.magic != _3DSX_MAGIC || hdr.dataSegSize < hdr.bssSize) return -2;
+
+	u32 segSizes[3] = {hdr.codeSegSize, hdr.rodataSegSize, hdr.dataSegSize};
+	refLoadable = hdr.dataSegSize - hdr.bssSize;
+	u32 used = 0;
+	for(i = 0; i < 3; i++) refSize[i] = (segSizes[i] + 0xFFF) & ~0xFFF;
+	refAddr[0] = BASE_ADDR;
+	refAddr[1] = refAddr[0] + refSize[0];
+	refAddr[2] = refAddr[1] + refSize[1];
+	u32 dataEnd = m->header.data_address + m->header.data_size;
+	if(refAddr[1] >= dataEnd || refSize[1] > dataEnd - refAddr[1])
+	{
+		refAddr[1] = LINEAR_ADDR + used;
+		used += refSize[1];
+	}
+	if(refAddr[2] < m->header.data_address) refAddr[2] = m->header.data_address;
+	if(refAddr[2] >= dataEnd || hdr.dataSegSize > dataEnd - refAddr[2])
+	{
+		refAddr[2] = LINEAR_ADDR + used;
+		used += refSize[2];
+	}
+
+	u32 nTables = hdr.relocHdrSize / 4;
+	const u8* p = file + hdr.headerSize;
+	const u8* tables = p;
+	p += 3 * nTables * 4;
+	for(i = 0; i < 3; i++)
+	{
+		refSeg[i] = calloc(refSize[i] + 3 * nTables * 4 + 4, 1);
+		u32 n = i < 2 ? segSizes[i] : segSizes[2] - hdr.bssSize;
+		if(hdr.flags & _3DSX_FLAG_LZ11)
+		{
+			// in one go, the loader's decoding comes in pieces
+			lz11_stream_t s;
+			u32 used = file + size - p, decoded = n;
+			lz11_stream_init(&s, NULL, 0);
+			if(lz11_stream_decode(&s, p, &used, refSeg[i], &decoded) != LZ11_STREAM_DONE || decoded != n) return -4;
+			p += (used + 3) & ~3;
+			continue;
+		}
+		if(p + n > file + size) return -4;
+		memcpy(refSeg[i], p, n);
+		p += n;
+	}
+	// where the loader keeps the relocation headers while it works
+	memcpy(refSeg[2] + segSizes[2] - hdr.bssSize, tables, 3 * nTables * 4);
+
+	*numPatched = 0;
+	for(i = 0; i < 3; i++)
+	{
+		for(j = 0; j < nTables; j++)
+		{
+			u32 n = word(&tables[(i * nTables + j) * 4]);
+			const u8* r = p;
+			p += n * 4;
+			if(j >= 2) continue;
+			if(p > file + size) return -7;
+
+			u32 w = 0, k;
+			for(k = 0; k < n && w < refSize[i] / 4; k++, r += 4)
+			{
+				u32 skip = r[0] | (r[1] << 8), patch = r[2] | (r[3] << 8), q;
+				w += skip;
+				for(q = 0; q < patch && w < refSize[i] / 4; q++, w++)
+				{
+					u32 v = word(&refSeg[i][w * 4]);
+					u32 off = v & 0x0FFFFFFF;
+					u32 addr;
+					if(off < refSize[0]) addr = refAddr[0] + off;
+					else if(off < refSize[0] + refSize[1]) addr = refAddr[1] + off - refSize[0];
+					else addr = refAddr[2] + off - refSize[0] - refSize[1];
+					if(j == 0)
+					{
+						if(v >> 28) return 7;
+					}else{
+						addr -= refAddr[i] + w * 4;
+						if(v >> 28 == 1) addr &= 0x7FFFFFFF;
+						else if(v >> 28) return 8;
+					}
+					memcpy(&refSeg[i][w * 4], &addr, 4);
+					(*numPatched)++;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static int check(_3DSX_Target* t)
+{
+	u32 i;
+	for(i = 0; i < 3; i++)
+	{
+		if(t->info.segAddrs[i] != refAddr[i] || t->info.segSizes[i] != refSize[i]) return -1;
+		// the fast path does not go through the relocation headers in .bss
+		u32 n = i == 2 && t->prelinked ? refLoadable : refSize[i];
+		if(memcmp(t->info.segOut[i], refSeg[i], n)) return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int i, failed = 0;
+	int iterations = 20;
+	const memorymap_t* m = app_maps[1];
+	bool posix = false;
+	bool pipeline = false;
+
+	for(i = 1; i < argc && argv[i][0] == '-'; i++)
+	{
+		if(!strncmp(argv[i], "--iterations=", 13) && atoi(&argv[i][13]) > 0) iterations = atoi(&argv[i][13]);
+		else if(!strncmp(argv[i], "--map=", 6) && targetMap(&argv[i][6])) m = targetMap(&argv[i][6]);
+		else if(!strcmp(argv[i], "--posix")) posix = true;
+		else if(!strcmp(argv[i], "--pipeline")) pipeline = true;
+		else if(!strncmp(argv[i], "--latency=", 10)) posixReadLatency = atoi(&argv[i][10]);
+		else if(!strncmp(argv[i], "--bandwidth=", 12)) posixReadBandwidth = atoi(&argv[i][12]);
+		else break;
+	}
+	if(i >= argc || argv[i][0] == '-')
+	{
+		printf("use : %s [--iterations=<n>] [--map=(<target process index> | <memorymap.bin>)] [--pipeline] [--posix [--latency=<microseconds per read>] [--bandwidth=<KB/s>]] <file.3dsx> ...\n", argv[0]);
+		return -1;
+	}
+
+	static u8 buffer[READBUFSIZE];
+
+	printf("%-32s %10s %8s %9s %6s %8s %12s %10s %10s\n", "", "relocs", "mapped", "prelinked", "reads", "KB read", "relocs/s", "MB/s", "ms/load");
+	for(; i < argc; i++)
+	{
+		u32 size;
+		u8* data = readFile(argv[i], &size);
+		if(!data)
+		{
+			printf("can't open %s\n", argv[i]);
+			failed = 1;
+			continue;
+		}
+
+		memfile_t mf = {data, size};
+		int fd = posix ? open(argv[i], O_RDONLY) : -1;
+		reader_backend_t backend = posix ? (reader_backend_t){posixRead, &fd} : (reader_backend_t){memRead, &mf};
+
+		u32 numPatched = 0;
+		int ret = reference(data, size, m, &numPatched);
+		if(ret)
+		{
+			printf("%-32s not loadable (%d)\n", argv[i], ret);
+			failed = 1;
+			continue;
+		}
+
+		targetClear();
+
+		_3DSX_Target t;
+		reader_t r;
+		double start = 0;
+		int n;
+		for(n = -1; n < iterations; n++)
+		{
+			// the first load is checked and not timed
+			if(n == 0) start = now();
+			targetInit(&t, m);
+			if(pipeline) t.pipeline = &posixPipeline;
+			readerInit(&r, backend, buffer, READBUFSIZE);
+			ret = Load3DSXSegments(&r, &t);
+			if(ret || (n < 0 && check(&t))) break;
+		}
+		double seconds = now() - start;
+
+		if(ret || n < iterations)
+		{
+			printf("%-32s failed (%d)\n", argv[i], ret);
+			failed = 1;
+		}else{
+			printf("%-32s %10u %8u %9s %6u %8u %12.0f %10.1f %10.3f\n", argv[i], numPatched, t.mappedSize, t.prelinked ? "yes" : "no", r.numReads, (u32)(r.bytesRead / 1024),
+				numPatched * (double)iterations / seconds, size * (double)iterations / seconds / 1e6, seconds * 1e3 / iterations);
+		}
+
+		for(n = 0; n < 3; n++) free(refSeg[n]);
+		if(fd >= 0) close(fd);
+		free(data);
+	}
+
+	return failed;
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "3dsx.h"
+#include "reader.h"
+#include "target.h"
+#include "../../compress/compress.h"
+#include "../../compress/lz11_stream.h"
+
+// Makes a _3DSX_FLAG_LZ11 file out of a 3DSX: its segments' file parts are
+// replaced by LZ11 streams, which Load3DSXSegments decodes as it reads them,
+// so that fewer bytes come off the SD card. Everything else stays as it was.
+// The result is loaded back and has to give the same segments.
+
+#define READBUFSIZE 0x8000
+
+// the extended header of 3DSX files with an SMDH or a RomFS, whose offsets are
+// from the start of the file
+#define EXTHDR_SIZE 0x2C
+#define EXTHDR_SMDH_OFFSET 0x20
+#define EXTHDR_ROMFS_OFFSET 0x28
+
+static int load(const u8* data, u32 size, const memorymap_t* m, _3DSX_Target* t)
+{
+	static u8 buffer[READBUFSIZE];
+	memfile_t mf = {data, size};
+	reader_t r;
+
+	targetClear();
+	targetInit(t, m);
+	readerInit(&r, (reader_backend_t){memRead, &mf}, buffer, READBUFSIZE);
+	return Load3DSXSegments(&r, t);
+}
+
+static void shift(u8* header, u32 offset, u32 from, u32 delta)
+{
+	u32 v;
+	memcpy(&v, &header[offset], 4);
+	if(v >= from) v += delta;
+	memcpy(&header[offset], &v, 4);
+}
+
+static u32 word(const u8* p)
+{
+	u32 v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+// the loader goes on at the word after where the stream's decoder stops, which
+// can be before a trailing flags byte the encoder leaves
+static size_t streamLength(const u8* packed, size_t len, u32 size)
+{
+	lz11_stream_t s;
+	u8* scratch = malloc(size ? size : 1);
+	u32 used = len, decoded = size;
+	lz11_stream_init(&s, NULL, 0);
+	int ret = lz11_stream_decode(&s, packed, &used, scratch, &decoded);
+	free(scratch);
+	return ret == LZ11_STREAM_DONE && decoded == size ? (used + 3) & ~3 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	lzss_options_t opts;
+	lzss_options_init(&opts);
+
+	int argi = 1;
+	if(argi < argc && !strcmp(argv[argi], "--optimal"))
+	{
+		opts.parser = LZSS_PARSER_OPTIMAL;
+		argi++;
+	}
+	if(argc - argi != 2)
+	{
+		printf("use : %s [--optimal] <in.3dsx> <out.3dsx>\n", argv[0]);
+		return -1;
+	}
+
+	u32 size;
+	u8* data = readFile(argv[argi], &size);
+	if(!data)
+	{
+		printf("can't read %s\n", argv[argi]);
+		return -2;
+	}
+
+	_3DSX_Header hdr;
+	_3DSX_Prelink prelink;
+	if(size < sizeof(hdr) || (memcpy(&hdr, data, sizeof(hdr)), hdr.magic != _3DSX_MAGIC)
+		|| hdr.headerSize > size || hdr.dataSegSize < hdr.bssSize)
+	{
+		printf("%s is not a 3DSX\n", argv[argi]);
+		return -2;
+	}
+	if(hdr.flags & _3DSX_FLAG_LZ11)
+	{
+		printf("%s is already compressed\n", argv[argi]);
+		return -2;
+	}
+	if(hdr.headerSize >= sizeof(hdr) + sizeof(prelink))
+	{
+		memcpy(&prelink, &data[hdr.headerSize - sizeof(prelink)], sizeof(prelink));
+		if(prelink.magic == _3DSX_PRELINK_MAGIC)
+		{
+			printf("%s is prelinked, compress it before prelinking it\n", argv[argi]);
+			return -2;
+		}
+	}
+
+	// where everything is
+	u32 nRelocTables = hdr.relocHdrSize / 4;
+	u64 segsStart = hdr.headerSize + 3 * (u64)hdr.relocHdrSize;
+	u32 segSizes[3] = {hdr.codeSegSize, hdr.rodataSegSize, hdr.dataSegSize - hdr.bssSize};
+	u64 relocsStart = segsStart + (u64)segSizes[0] + segSizes[1] + segSizes[2];
+	u64 relocsEnd = relocsStart;
+	u32 i;
+	if(segsStart <= size)
+		for(i = 0; i < 3 * nRelocTables; i++)
+			relocsEnd += (u64)word(&data[hdr.headerSize + (i / nRelocTables) * hdr.relocHdrSize + (i % nRelocTables) * 4]) * 4;
+	if(relocsEnd > size)
+	{
+		printf("%s is truncated\n", argv[argi]);
+		return -2;
+	}
+
+	size_t packedSize[3];
+	u8* packed[3];
+	const u8* p = &data[segsStart];
+	u32 outSize = segsStart + (relocsEnd - relocsStart) + (size - relocsEnd);
+	for(i = 0; i < 3; i++)
+	{
+		packed[i] = lz11_encode_opts(p, segSizes[i], &packedSize[i], &opts);
+		if(packed[i])
+			packedSize[i] = streamLength(packed[i], packedSize[i], segSizes[i]);
+		if(!packed[i] || !packedSize[i])
+		{
+			printf("can't compress %s\n", argv[argi]);
+			return -4;
+		}
+		p += segSizes[i];
+		outSize += packedSize[i];
+	}
+	// incompressible segments grow a little, and then cost more to read
+	if(outSize >= size)
+	{
+		printf("%s does not get smaller (0x%X -> 0x%X bytes), %s not written\n", argv[argi], size, outSize, argv[argi + 1]);
+		return -5;
+	}
+
+	u8* out = malloc(outSize);
+	u8* q = out;
+	memcpy(q, data, segsStart);
+	q += segsStart;
+	for(i = 0; i < 3; i++)
+	{
+		memcpy(q, packed[i], packedSize[i]);
+		q += packedSize[i];
+	}
+	memcpy(q, &data[relocsStart], size - relocsStart);
+
+	((_3DSX_Header*)out)->flags |= _3DSX_FLAG_LZ11;
+	u32 delta = (u32)(q - out) - (u32)relocsStart;
+	if(hdr.headerSize >= EXTHDR_SIZE)
+	{
+		shift(out, EXTHDR_SMDH_OFFSET, relocsEnd, delta);
+		shift(out, EXTHDR_ROMFS_OFFSET, relocsEnd, delta);
+	}
+
+	// both have to load the same, relocation headers in .bss and all
+	const memorymap_t* m = app_maps[1];
+	_3DSX_Target t;
+	u8* expected[3];
+	int ret = load(data, size, m, &t);
+	if(ret)
+	{
+		printf("%s does not load (%d)\n", argv[argi], ret);
+		return -2;
+	}
+	_3DSX_LoadInfo info = t.info;
+	for(i = 0; i < 3; i++)
+	{
+		expected[i] = malloc(info.segSizes[i]);
+		memcpy(expected[i], info.segOut[i], info.segSizes[i]);
+	}
+	ret = load(out, outSize, m, &t);
+	for(i = 0; i < 3 && !ret; i++)
+		if(t.info.segAddrs[i] != info.segAddrs[i] || memcmp(t.info.segOut[i], expected[i], info.segSizes[i]))
+			ret = -1;
+	if(ret)
+	{
+		printf("%s does not load back the same (%d)\n", argv[argi + 1], ret);
+		return -4;
+	}
+
+	FILE* f = fopen(argv[argi + 1], "wb");
+	if(!f || fwrite(out, 1, outSize, f) != outSize)
+	{
+		printf("can't write %s\n", argv[argi + 1]);
+		return -3;
+	}
+	fclose(f);
+
+	u32 raw = segSizes[0] + segSizes[1] + segSizes[2];
+	u32 compressed = packedSize[0] + packedSize[1] + packedSize[2];
+	printf("%s : segments 0x%X -> 0x%X bytes (%.1f%%), file 0x%X -> 0x%X bytes\n", argv[argi + 1],
+		raw, compressed, raw ? compressed * 100.0 / raw : 100.0, size, outSize);
+
+	return 0;
+}
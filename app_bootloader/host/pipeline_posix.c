@@ -0,0 +1,47 @@
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "pipeline_posix.h"
+
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond[2] = {PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+static bool signaled[2];
+static u32 buffer[0x20000/4]; // as much as on the 3DS
+static void (*threadWork)(void* arg);
+
+static void* entry(void* arg)
+{
+	threadWork(arg);
+	return NULL;
+}
+
+static Result start(void (*work)(void* arg), void* arg)
+{
+	signaled[0] = signaled[1] = false;
+	threadWork = work;
+	return pthread_create(&thread, NULL, entry, arg) ? -1 : 0;
+}
+
+static void join()
+{
+	pthread_join(thread, NULL);
+}
+
+static void signal(u32 event)
+{
+	pthread_mutex_lock(&lock);
+	signaled[event] = true;
+	pthread_cond_signal(&cond[event]);
+	pthread_mutex_unlock(&lock);
+}
+
+static void wait(u32 event)
+{
+	pthread_mutex_lock(&lock);
+	while(!signaled[event]) pthread_cond_wait(&cond[event], &lock);
+	signaled[event] = false;
+	pthread_mutex_unlock(&lock);
+}
+
+const _3DSX_Pipeline posixPipeline = {start, join, signal, wait, buffer, sizeof(buffer)};
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "3dsx.h"
+
+// _3DSX_Pipeline on a pthread, the events being flags under a mutex
+extern const _3DSX_Pipeline posixPipeline;
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "3dsx.h"
+#include "reader.h"
+#include "target.h"
+
+// Prelinks a 3DSX for a target process's memory map, see _3DSX_Prelink: loads
+// it the way setup3dsx would for that map and appends the relocated segments,
+// which Load3DSXSegments then reads as they are when it is given the same map.
+// The file stays a 3DSX which loads anywhere else, only its header grows.
+
+#define READBUFSIZE 0x8000
+
+// the extended header of 3DSX files with an SMDH or a RomFS, whose offsets are
+// from the start of the file
+#define EXTHDR_SIZE 0x2C
+#define EXTHDR_SMDH_OFFSET 0x20
+#define EXTHDR_ROMFS_OFFSET 0x28
+
+static int load(const u8* data, u32 size, const memorymap_t* m, u32 mapHash, _3DSX_Target* t)
+{
+	static u8 buffer[READBUFSIZE];
+	memfile_t mf = {data, size};
+	reader_t r;
+
+	targetClear();
+	targetInit(t, m);
+	t->mapHash = mapHash;
+	readerInit(&r, (reader_backend_t){memRead, &mf}, buffer, READBUFSIZE);
+	return Load3DSXSegments(&r, t);
+}
+
+static void shift(u8* header, u32 offset, u32 delta)
+{
+	u32 v;
+	memcpy(&v, &header[offset], 4);
+	if(v) v += delta;
+	memcpy(&header[offset], &v, 4);
+}
+
+int main(int argc, char** argv)
+{
+	if(argc != 4)
+	{
+		printf("use : %s <in.3dsx> <out.3dsx> (<target process index> | <memorymap.bin>)\n", argv[0]);
+		return -1;
+	}
+
+	u32 size;
+	u8* data = readFile(argv[1], &size);
+	if(!data)
+	{
+		printf("can't read %s\n", argv[1]);
+		return -2;
+	}
+
+	const memorymap_t* m = targetMap(argv[3]);
+	if(!m)
+	{
+		printf("%s is neither a target process index nor a memory map\n", argv[3]);
+		return -2;
+	}
+	u32 mapHash = targetMapHash(m);
+
+	// the 3DS's copy of the map has the region's TID low and such where the
+	// host's has 0, and must still hash the same for the file to be prelinked
+	memorymap_t* other = malloc(size_memmap(*m));
+	memcpy(other, m, size_memmap(*m));
+	u32 layoutSize = offsetof(memorymap_header_t, processLinearOffset);
+	memset((u8*)&other->header + layoutSize, 0xA5, sizeof(memorymap_header_t) - layoutSize);
+	if(targetMapHash(other) != mapHash)
+	{
+		printf("the map's hash depends on more than where things go\n");
+		return -4;
+	}
+	free(other);
+
+	_3DSX_Header hdr;
+	_3DSX_Prelink prelink;
+	if(size < sizeof(hdr))
+	{
+		printf("%s is not a 3DSX\n", argv[1]);
+		return -2;
+	}
+	memcpy(&hdr, data, sizeof(hdr));
+	if(hdr.headerSize >= sizeof(hdr) + sizeof(prelink) && hdr.headerSize <= size)
+	{
+		memcpy(&prelink, &data[hdr.headerSize - sizeof(prelink)], sizeof(prelink));
+		if(prelink.magic == _3DSX_PRELINK_MAGIC)
+		{
+			printf("%s is already prelinked\n", argv[1]);
+			return -2;
+		}
+	}
+
+	_3DSX_Target t;
+	int ret = load(data, size, m, mapHash, &t);
+	if(ret)
+	{
+		printf("%s does not load (%d)\n", argv[1], ret);
+		return -2;
+	}
+	if(t.mappedSize)
+	{
+		printf("%s does not fit in that map's data region, where its segments go is only known at boot\n", argv[1]);
+		return -4;
+	}
+	if(hdr.headerSize + sizeof(prelink) > 0xFFFF)
+	{
+		printf("%s's header is too large\n", argv[1]);
+		return -4;
+	}
+
+	u32 segSizes[3] = {hdr.codeSegSize, hdr.rodataSegSize, hdr.dataSegSize - hdr.bssSize};
+	u32 offset = (size + sizeof(prelink) + READER_ALIGN - 1) & ~(READER_ALIGN - 1);
+	u32 outSize = offset + segSizes[0] + segSizes[1] + segSizes[2];
+	u8* out = calloc(outSize, 1);
+
+	// the original file with the prelink block at the end of its header
+	memcpy(out, data, hdr.headerSize);
+	memcpy(&out[hdr.headerSize + sizeof(prelink)], &data[hdr.headerSize], size - hdr.headerSize);
+	((_3DSX_Header*)out)->headerSize = hdr.headerSize + sizeof(prelink);
+	if(hdr.headerSize >= EXTHDR_SIZE)
+	{
+		shift(out, EXTHDR_SMDH_OFFSET, sizeof(prelink));
+		shift(out, EXTHDR_ROMFS_OFFSET, sizeof(prelink));
+	}
+
+	prelink.magic = _3DSX_PRELINK_MAGIC;
+	prelink.mapHash = mapHash;
+	prelink.baseAddr = t.baseAddr;
+	memcpy(prelink.segAddrs, t.info.segAddrs, sizeof(prelink.segAddrs));
+	prelink.offset = offset;
+	prelink.size = outSize - offset;
+	memcpy(&out[hdr.headerSize], &prelink, sizeof(prelink));
+
+	u32 i;
+	u8* p = &out[offset];
+	for(i = 0; i < 3; i++)
+	{
+		memcpy(p, t.info.segOut[i], segSizes[i]);
+		p += segSizes[i];
+	}
+
+	// the fast path has to give what was just relocated, and other maps have to
+	// fall back to relocating
+	for(i = 0; i < 2; i++)
+	{
+		ret = load(out, outSize, m, i ? ~mapHash : mapHash, &t);
+		if(ret || t.prelinked != !i) break;
+		u32 j;
+		for(p = &out[offset], j = 0; j < 3; p += segSizes[j], j++)
+			if(memcmp(t.info.segOut[j], p, segSizes[j])) break;
+		if(j < 3) break;
+	}
+	if(i < 2)
+	{
+		printf("%s does not load back the same (%d)\n", argv[2], ret);
+		return -4;
+	}
+
+	FILE* f = fopen(argv[2], "wb");
+	if(!f || fwrite(out, 1, outSize, f) != outSize)
+	{
+		printf("can't write %s\n", argv[2]);
+		return -3;
+	}
+	fclose(f);
+
+	printf("%s : map %08X, code at %08X, rodata at %08X, data at %08X\n", argv[2], mapHash,
+		prelink.segAddrs[0], prelink.segAddrs[1], prelink.segAddrs[2]);
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+#define _XOPEN_SOURCE 700
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "reader_posix.h"
+
+u32 posixReadLatency = 0;
+u32 posixReadBandwidth = 0;
+
+// reads are served in the order they come in
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t turn = PTHREAD_COND_INITIALIZER;
+static u32 nextTicket, serving;
+
+Result posixRead(void* file, u64 offset, void* dst, u32 size, u32* bytesRead)
+{
+	int fd = *(int*)file;
+	Result ret = 0;
+
+	pthread_mutex_lock(&lock);
+	u32 ticket = nextTicket++;
+	while(ticket != serving) pthread_cond_wait(&turn, &lock);
+	pthread_mutex_unlock(&lock);
+
+	u64 us = posixReadLatency;
+	if(posixReadBandwidth) us += (u64)size * 1000000 / ((u64)posixReadBandwidth * 1024);
+	if(us)
+	{
+		struct timespec t = {us / 1000000, (us % 1000000) * 1000};
+		nanosleep(&t, NULL);
+	}
+
+	*bytesRead = 0;
+	while(*bytesRead < size)
+	{
+		ssize_t n = pread(fd, (u8*)dst + *bytesRead, size - *bytesRead, offset + *bytesRead);
+		if(n < 0) ret = -1;
+		if(n <= 0) break;
+		*bytesRead += n;
+	}
+	pthread_mutex_lock(&lock);
+	serving++;
+	pthread_cond_broadcast(&turn);
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <ctr/types.h>
+
+// reader_t backend on a POSIX file descriptor, file points to the fd;
+// posixReadLatency adds that many microseconds to each read, as an IPC, and
+// posixReadBandwidth, in KB/s, makes reads take as long as on an SD card;
+// reads are served one at a time, as FS does
+extern u32 posixReadLatency;
+extern u32 posixReadBandwidth;
+
+Result posixRead(void* file, u64 offset, void* dst, u32 size, u32* bytesRead);
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "3dsx.h"
+#include "reader.h"
+#include "reader_posix.h"
+
+// What reading a 3DSX the way Load3DSX does costs, in backend reads (IPCs on
+// the 3DS) and time: once unbuffered, one read per request and per batch of
+// 512 relocations as it used to be, and once through the buffered reader.
+// Both have to read the same bytes.
+
+#define READBUFSIZE 0x8000
+#define RELOCBUFSIZE 512
+
+typedef struct
+{
+	u32 numReads;
+	u64 bytesRead;
+	double seconds;
+	u32 hash;
+} result_t;
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static u32 fnv(u32 h, const void* data, u32 size)
+{
+	const u8* p = data;
+	while(size--) h = (h ^ *p++) * 16777619;
+	return h;
+}
+
+// Load3DSX's reads, hashing what they return; buffered walks the relocations
+// with readerNext
+static int replay(reader_t* r, int buffered, u32* hash)
+{
+	_3DSX_Header hdr;
+	u32 i, j;
+
+	*hash = 2166136261u;
+	if(readerRead(r, &hdr, sizeof(hdr))) return -1;
+	if(hdr.magic != _3DSX_MAGIC) return -2;
+	if(hdr.dataSegSize < hdr.bssSize) return -2;
+	// decoded as they are read, which the unbuffered replay cannot do
+	if(hdr.flags & _3DSX_FLAG_LZ11) return -8;
+	*hash = fnv(*hash, &hdr, sizeof(hdr));
+
+	readerSeek(r, hdr.headerSize);
+
+	u32 nRelocTables = hdr.relocHdrSize / 4;
+	u32* relocs = malloc(3 * nRelocTables * 4 + 4);
+	for(i = 0; i < 3; i++)
+		if(readerRead(r, &relocs[i * nRelocTables], nRelocTables * 4)) return -3;
+	*hash = fnv(*hash, relocs, 3 * nRelocTables * 4);
+
+	u32 sizes[3] = {hdr.codeSegSize, hdr.rodataSegSize, hdr.dataSegSize - hdr.bssSize};
+	for(i = 0; i < 3; i++)
+	{
+		u8* seg = malloc(sizes[i] + 1);
+		if(readerRead(r, seg, sizes[i])) return -4 - i;
+		*hash = fnv(*hash, seg, sizes[i]);
+		free(seg);
+	}
+
+	static _3DSX_Reloc relocTbl[RELOCBUFSIZE];
+	for(i = 0; i < 3; i++)
+	{
+		for(j = 0; j < nRelocTables; j++)
+		{
+			u32 nRelocs = relocs[i * nRelocTables + j];
+			if(j >= 2)
+			{
+				readerSkip(r, (u64)nRelocs * sizeof(_3DSX_Reloc));
+				continue;
+			}
+			while(nRelocs)
+			{
+				const _3DSX_Reloc* tbl = relocTbl;
+				u32 toDo;
+				if(buffered)
+				{
+					toDo = readerNext(r, (const void**)&tbl, sizeof(_3DSX_Reloc), nRelocs);
+					if(!toDo) return -7;
+				}else{
+					toDo = nRelocs > RELOCBUFSIZE ? RELOCBUFSIZE : nRelocs;
+					if(readerRead(r, relocTbl, toDo * sizeof(_3DSX_Reloc))) return -7;
+				}
+				nRelocs -= toDo;
+				*hash = fnv(*hash, tbl, toDo * sizeof(_3DSX_Reloc));
+			}
+		}
+	}
+
+	free(relocs);
+	return 0;
+}
+
+static int run(int fd, int buffered, result_t* res)
+{
+	static u8 buffer[READBUFSIZE];
+	reader_t r;
+	readerInit(&r, (reader_backend_t){posixRead, &fd}, buffer, buffered ? READBUFSIZE : 0);
+
+	double start = now();
+	int ret = replay(&r, buffered, &res->hash);
+	res->seconds = now() - start;
+	res->numReads = r.numReads;
+	res->bytesRead = r.bytesRead;
+	return ret;
+}
+
+int main(int argc, char** argv)
+{
+	int i, failed = 0;
+	int first = 1;
+
+	if(argc > 1 && !strncmp(argv[1], "--latency=", 10))
+	{
+		posixReadLatency = atoi(&argv[1][10]);
+		first++;
+	}
+	if(first >= argc)
+	{
+		printf("use : %s [--latency=<microseconds per read>] <file.3dsx> ...\n", argv[0]);
+		return -1;
+	}
+
+	printf("%-32s %10s %10s %12s %12s %10s %10s\n", "", "reads", "buffered", "bytes", "buffered", "ms", "buffered");
+	for(i = first; i < argc; i++)
+	{
+		int fd = open(argv[i], O_RDONLY);
+		if(fd < 0)
+		{
+			printf("can't open %s\n", argv[i]);
+			failed = 1;
+			continue;
+		}
+
+		result_t a, b;
+		int ra = run(fd, 0, &a);
+		int rb = run(fd, 1, &b);
+		close(fd);
+
+		if(ra == -8)
+		{
+			printf("%-32s has LZ11 segments, only Load3DSXSegments reads those, see bench.exe\n", argv[i]);
+			failed = 1;
+			continue;
+		}
+		if(ra || rb || a.hash != b.hash)
+		{
+			printf("%-32s failed (%d, %d, %s)\n", argv[i], ra, rb, a.hash == b.hash ? "same data" : "different data");
+			failed = 1;
+			continue;
+		}
+		printf("%-32s %10u %10u %12llu %12llu %10.2f %10.2f\n", argv[i], a.numReads, b.numReads,
+			(unsigned long long)a.bytesRead, (unsigned long long)b.bytesRead, a.seconds * 1e3, b.seconds * 1e3);
+	}
+
+	return failed;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "target.h"
+
+static u8* output;
+static u8* linear;
+static u32 linearUsed;
+
+static void* getOutput()
+{
+	return output;
+}
+
+static Result mapSegment(u32* addr, void** out, u32 size)
+{
+	if(size > LINEAR_SIZE - linearUsed) return -1;
+	*addr = LINEAR_ADDR + linearUsed;
+	*out = &linear[linearUsed];
+	linearUsed += size;
+	return 0;
+}
+
+Result memRead(void* file, u64 offset, void* dst, u32 size, u32* bytesRead)
+{
+	memfile_t* f = file;
+	*bytesRead = 0;
+	if(offset >= f->size) return 0;
+	if(size > f->size - offset) size = f->size - offset;
+	memcpy(dst, &f->data[offset], size);
+	*bytesRead = size;
+	return 0;
+}
+
+u8* readFile(const char* path, u32* size)
+{
+	FILE* f = fopen(path, "rb");
+	if(!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	u8* data = malloc(*size ? *size : 1);
+	if(data && fread(data, 1, *size, f) != *size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+const memorymap_t* targetMap(const char* arg)
+{
+	const char* p = arg;
+	while(isdigit((unsigned char)*p)) p++;
+	if(p != arg && !*p)
+		return atoi(arg) < numTargetProcesses ? app_maps[atoi(arg)] : NULL;
+
+	u32 size;
+	memorymap_t* m = (memorymap_t*)readFile(arg, &size);
+	if(m && (size < sizeof(memorymap_header_t) || size != size_memmap(*m)))
+	{
+		free(m);
+		m = NULL;
+	}
+	return m;
+}
+
+static void allocate()
+{
+	if(output) return;
+	output = calloc(OUTPUT_SIZE, 1);
+	linear = calloc(LINEAR_SIZE, 1);
+}
+
+u32 targetMapHash(const memorymap_t* m)
+{
+	return _3DSX_MapHash(&m->header, offsetof(memorymap_header_t, processLinearOffset), m->map, sizeof(memorymap_entry_t) * m->header.num);
+}
+
+void targetInit(_3DSX_Target* t, const memorymap_t* m)
+{
+	allocate();
+	memset(t, 0, sizeof(*t));
+	t->baseAddr = BASE_ADDR;
+	t->dataAddr = m->header.data_address;
+	t->dataSize = m->header.data_size;
+	t->mapHash = targetMapHash(m);
+	t->getOutput = getOutput;
+	t->mapSegment = mapSegment;
+	linearUsed = 0;
+}
+
+void targetClear()
+{
+	allocate();
+	memset(output, 0, OUTPUT_SIZE);
+	memset(linear, 0, LINEAR_SIZE);
+}
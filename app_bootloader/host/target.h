@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ctr/types.h>
+
+#include "3dsx.h"
+
+// the constants app_targets.h needs, its maps' data regions do not depend on them
+#define FIRM_APPMEMALLOC 0
+#define IS_N3DS 1
+#define CAMAPP_TIDLOW 0
+#define DLPLAY_TIDLOW 0
+#define ACTAPP_TIDLOW 0
+#define MSET_TIDLOW 0
+#define NFACE_TIDLOW 0
+
+#include "../../app_targets/app_targets.h"
+
+// Load3DSXSegments on the host, into a simulated address space laid out the
+// way setup3dsx does it for a target process: the image at 0x00108000, written
+// through an output buffer as large as the GSP heap window getOutputBaseAddr
+// gives, with segments which do not fit in the process's data region in
+// "linear heap" pages at 0x14000000 on.
+
+#define BASE_ADDR 0x00108000
+#define OUTPUT_SIZE 0x00F00000
+#define LINEAR_ADDR 0x14000000
+#define LINEAR_SIZE 0x04000000
+
+typedef struct
+{
+	const u8* data;
+	u32 size;
+} memfile_t;
+
+// reader_t backend on a memfile_t
+Result memRead(void* file, u64 offset, void* dst, u32 size, u32* bytesRead);
+
+// the whole file, NULL if it can't be read
+u8* readFile(const char* path, u32* size);
+
+// app_maps[arg] for a target process index, else the memorymap_t in file arg,
+// NULL if it is neither
+const memorymap_t* targetMap(const char* arg);
+
+// _3DSX_MapHash of m, as setup3dsx takes it
+u32 targetMapHash(const memorymap_t* m);
+
+// a target for m with nothing mapped yet, mapHash set to m's
+void targetInit(_3DSX_Target* t, const memorymap_t* m);
+// zeroes the address space, what is past the segments' file data is left as
+// it was when loading, as on the 3DS
+void targetClear();
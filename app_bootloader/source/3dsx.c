@@ -8,6 +8,7 @@
 #include "../../build/constants.h"
 
 #include "3dsx.h"
+#include "reader.h"
 #include "sys.h"
 
 // TODO : find a better place to put this
@@ -16,60 +17,81 @@
 
 //code by fincs
 
-#define RELOCBUFSIZE 512
-#define SEC_ASSERT(x) if(!(x)) return 0x5ECDEAD
-
-typedef struct
+static Result fsRead(void* file, u64 offset, void* dst, u32 size, u32* bytesRead)
 {
-	void* segPtrs[3]; // code, rodata & data
-	u32 segSizes[3];
-} _3DSX_LoadInfo;
+	return FSFILE_Read(*(Handle*)file, bytesRead, offset, (u32*)dst, size);
+}
 
-static inline void* TranslateAddr(u32 addr, _3DSX_LoadInfo* d, u32* offsets)
+static Result mapSegment(u32* addr, void** out, u32 size)
 {
-	if (addr < offsets[0])
-		return (char*)d->segPtrs[0] + addr;
-	if (addr < offsets[1])
-		return (char*)d->segPtrs[1] + addr - offsets[0];
-	return (char*)d->segPtrs[2] + addr - offsets[1];
+	Result ret = svc_controlMemory(addr, 0x0, 0x0, size, 0x10003, 0x3);
+	*out = (void*)*addr;
+	return ret;
 }
 
-u64 fileOffset;
+// the segments are read on a thread of their own while the ones before are
+// relocated, FS doing the reading while that thread waits on its IPC
+#define PIPELINE_STACKSIZE 0x1000
+#define PIPELINE_BUFSIZE 0x20000
+
+// the reader's buffer, then the pipeline's ring and its thread's stack, in
+// pages mapped for the load only, as the bss is in the little heap main.c has
+#define READBUFSIZE 0x8000
+#define SCRATCHSIZE (READBUFSIZE + PIPELINE_BUFSIZE + PIPELINE_STACKSIZE)
+
+static Handle pipelineThread, pipelineEvents[2];
+static void (*pipelineWork)(void* arg);
+static u32* pipelineStack; // its top
 
-int _fread(void* dst, int size, Handle file)
+static void pipelineEntry(u32 arg)
 {
-	u32 bytesRead;
-	Result ret;
-	if((ret=FSFILE_Read(file, &bytesRead, fileOffset, (u32*)dst, size))!=0)return ret;
-	fileOffset+=bytesRead;
-	return (bytesRead==size)?0:-1;
+	pipelineWork((void*)arg);
+	svc_exitThread();
 }
 
-int _fseek(Handle file, u64 offset, int origin)
+static Result pipelineStart(void (*work)(void* arg), void* arg)
 {
-	switch(origin)
+	Result ret = svc_createEvent(&pipelineEvents[0], 0);
+	if (ret) return ret;
+	ret = svc_createEvent(&pipelineEvents[1], 0);
+	if (ret)
 	{
-		case SEEK_SET:
-			fileOffset=offset;
-			break;
-		case SEEK_CUR:
-			fileOffset+=offset;
-			break;
+		svc_closeHandle(pipelineEvents[0]);
+		return ret;
 	}
-	return 0;
+
+	// above the loader's priority, so that the next read goes out as soon as
+	// one is in, on the same core
+	pipelineWork = work;
+	ret = svc_createThread(&pipelineThread, pipelineEntry, (u32)arg, pipelineStack, 0x18, 0xFFFFFFFE);
+	if (ret)
+	{
+		svc_closeHandle(pipelineEvents[0]);
+		svc_closeHandle(pipelineEvents[1]);
+	}
+	return ret;
+}
+
+static void pipelineJoin()
+{
+	svc_waitSynchronization1(pipelineThread, U64_MAX);
+	svc_closeHandle(pipelineThread);
+	svc_closeHandle(pipelineEvents[0]);
+	svc_closeHandle(pipelineEvents[1]);
 }
 
-void* _getActualAddress(void* addr, void* baseAddr, void* outputBaseAddr)
+static void pipelineSignal(u32 event)
 {
-	if(addr < 0x14000000) return addr - baseAddr + outputBaseAddr;
-	else return addr;
+	svc_signalEvent(pipelineEvents[event]);
 }
 
-#define getActualAddress(addr) _getActualAddress(addr, baseAddr, outputBaseAddr)
+static void pipelineWait(u32 event)
+{
+	svc_waitSynchronization1(pipelineEvents[event], U64_MAX);
+}
 
-int Load3DSX(Handle file, void* baseAddr, void* dataAddr, u32 dataSize, service_list_t* __service_ptr, u32* argbuf)
+int Load3DSX(Handle file, void* baseAddr, void* dataAddr, u32 dataSize, u32 mapHash, service_list_t* __service_ptr, u32* argbuf)
 {
-	u32 i, j, k, m;
 	// u32 endAddr = 0x00100000+CN_NEWTOTALPAGES*0x1000;
 
 	Handle resourceLimit = 0;
@@ -85,153 +107,36 @@ int Load3DSX(Handle file, void* baseAddr, void* dataAddr, u32 dataSize, service_
 	u32 heap_size = limit_commit - (current_commit - _heap_size); // gsp heap not allocated at this point, otherwise would also have to do - _gsp_heap_size
 	heap_size -= 1*1024*1024; // reserve 1MB because ctrulib likes to allocate stuff
 
-	SEC_ASSERT(baseAddr >= (void*)0x00100000);
-	SEC_ASSERT((((u32) baseAddr) & 0xFFF) == 0); // page alignment
-
-	_fseek(file, 0x0, SEEK_SET);
-
-	_3DSX_Header hdr;
-	if (_fread(&hdr, sizeof(hdr), file) != 0)
-		return -1;
-
-	if (hdr.magic != _3DSX_MAGIC)
-		return -2;
-
-	_3DSX_LoadInfo d;
-	d.segSizes[0] = (hdr.codeSegSize+0xFFF) &~ 0xFFF;
-	SEC_ASSERT(d.segSizes[0] >= hdr.codeSegSize); // int overflow
-	d.segSizes[1] = (hdr.rodataSegSize+0xFFF) &~ 0xFFF;
-	SEC_ASSERT(d.segSizes[1] >= hdr.rodataSegSize); // int overflow
-	d.segSizes[2] = (hdr.dataSegSize+0xFFF) &~ 0xFFF;
-	SEC_ASSERT(d.segSizes[2] >= hdr.dataSegSize); // int overflow
-
-	// u32 pagesRequired = d.segSizes[0]/0x1000 + d.segSizes[1]/0x1000 + d.segSizes[2]/0x1000; // XXX: int overflow
-	// if(pagesRequired > CN_TOTAL3DSXPAGES)return -13;
-
-	u32 offsets[2] = { d.segSizes[0], d.segSizes[0] + d.segSizes[1] };
-	d.segPtrs[0] = baseAddr;
-	d.segPtrs[1] = (char*)d.segPtrs[0] + d.segSizes[0];
-	SEC_ASSERT((u32)d.segPtrs[1] >= d.segSizes[0]); // int overflow
-	d.segPtrs[2] = (char*)d.segPtrs[1] + d.segSizes[1];
-	SEC_ASSERT((u32)d.segPtrs[2] >= d.segSizes[1]); // int overflow
-
-	// not enough room for rodata/data ? no problem dawg
-	if(((u32)d.segPtrs[1] >= (u32)dataAddr + dataSize) || d.segSizes[1] > (u32)dataAddr + dataSize - (u32)d.segPtrs[1])
-	{
-		// no room for rodata
-		svc_controlMemory(&d.segPtrs[1], 0x0, 0x0, d.segSizes[1], 0x10003, 0x3);
-		heap_size -= d.segSizes[1];
-	}
-	
-	if(d.segPtrs[2] < dataAddr)d.segPtrs[2] = dataAddr;
-
-	if(((u32)d.segPtrs[2] >= (u32)dataAddr + dataSize) || (hdr.dataSegSize > dataSize - ((u32)d.segPtrs[2] - (u32)dataAddr)))
+	// without room for the pipeline's part, the segments are read before any
+	// of them is relocated
+	u32 scratch, scratchSize = SCRATCHSIZE;
+	if (svc_controlMemory(&scratch, 0x0, 0x0, scratchSize, 0x10003, 0x3))
 	{
-		// no room for data
-		svc_controlMemory(&d.segPtrs[2], 0x0, 0x0, d.segSizes[2], 0x10003, 0x3);
-		heap_size -= d.segSizes[2];
+		scratchSize = READBUFSIZE;
+		if ((ret = svc_controlMemory(&scratch, 0x0, 0x0, scratchSize, 0x10003, 0x3)) != 0)
+			return ret;
 	}
+	_3DSX_Pipeline pipeline = {pipelineStart, pipelineJoin, pipelineSignal, pipelineWait, (void*)(scratch + READBUFSIZE), PIPELINE_BUFSIZE};
+	pipelineStack = (u32*)(scratch + SCRATCHSIZE);
 
-	void* outputBaseAddr = getOutputBaseAddr();
+	reader_t reader;
+	readerInit(&reader, (reader_backend_t){fsRead, &file}, (u8*)scratch, READBUFSIZE);
 
-	// SEC_ASSERT((u32)d.segPtrs[2] < endAddr); // within user memory
-
-	// Skip header for future compatibility.
-	_fseek(file, hdr.headerSize, SEEK_SET);
-	
-	// Read the relocation headers
-	SEC_ASSERT(hdr.dataSegSize >= hdr.bssSize); // int underflow
-	u32* relocs = (u32*)((char*)d.segPtrs[2] + hdr.dataSegSize - hdr.bssSize);
-	SEC_ASSERT((u32)relocs >= (u32)d.segPtrs[2]); // int overflow
-	// SEC_ASSERT((u32)relocs < endAddr); // within user memory
-	u32 nRelocTables = hdr.relocHdrSize/4;
- 
-	u32 relocsEnd = (u32)(relocs + 3*nRelocTables);
-	SEC_ASSERT((u32)relocsEnd >= (u32)relocs); // int overflow
-	// SEC_ASSERT((u32)relocsEnd < endAddr); // within user memory
-
-	relocs = getActualAddress(relocs);
-
-	// XXX: Ensure enough RW pages exist at baseAddr to hold a memory block of length "totalSize".
-	//    This also checks whether the memory region overflows into IPC data or loader data.
- 
-	for (i = 0; i < 3; i ++)
-		if (_fread(&relocs[i*nRelocTables], nRelocTables*4, file) != 0)
-			return -3;
- 
-	// Read the segments
-	if (_fread(getActualAddress(d.segPtrs[0]), hdr.codeSegSize, file) != 0) return -4;
-	if (_fread(getActualAddress(d.segPtrs[1]), hdr.rodataSegSize, file) != 0) return -5;
-	if (_fread(getActualAddress(d.segPtrs[2]), hdr.dataSegSize - hdr.bssSize, file) != 0) return -6;
- 
-	// Relocate the segments
-	for (i = 0; i < 3; i ++)
-	{
-		for (j = 0; j < nRelocTables; j ++)
-		{
-			u32 nRelocs = relocs[i*nRelocTables+j];
-			if (j >= 2)
-			{
-				// We are not using this table - ignore it
-				_fseek(file, nRelocs*sizeof(_3DSX_Reloc), SEEK_CUR);
-				continue;
-			}
- 
-			static _3DSX_Reloc relocTbl[RELOCBUFSIZE];
- 
-			u32* pos = (u32*)d.segPtrs[i];
-			u32* endPos = pos + (d.segSizes[i]/4);
-			// SEC_ASSERT(((u32) endPos) < endAddr); // within user memory
-
-			while (nRelocs)
-			{
-				u32 toDo = nRelocs > RELOCBUFSIZE ? RELOCBUFSIZE : nRelocs;
-				nRelocs -= toDo;
- 
-				if (_fread(relocTbl, toDo*sizeof(_3DSX_Reloc), file) != 0)
-					return -7;
- 
-				for (k = 0; k < toDo && pos < endPos; k ++)
-				{
-					pos += relocTbl[k].skip;
-					u32 num_patches = relocTbl[k].patch;
-					for (m = 0; m < num_patches && pos < endPos; m ++)
-					{
-						u32 origData = *(u32*)getActualAddress(pos);
-						u32 subType = origData >> (32-4);
-						u32 addr = TranslateAddr(origData &~ 0xF0000000, &d, offsets);
+	// u32 pagesRequired = d.segSizes[0]/0x1000 + d.segSizes[1]/0x1000 + d.segSizes[2]/0x1000; // XXX: int overflow
+	// if(pagesRequired > CN_TOTAL3DSXPAGES)return -13;
 
-						// SEC_ASSERT(((u32) pos) < endAddr); // within user memory
-						switch (j)
-						{
-							case 0:
-							{
-								if (subType != 0)
-									return 7;
-								*(u32*)getActualAddress(pos) = addr;
-								break;
-							}
-							case 1:
-							{
-								u32 data = addr - (int)pos;
-								switch (subType)
-								{
-									case 0: *(u32*)getActualAddress(pos) = (data);            break; // 32-bit signed offset
-									case 1: *(u32*)getActualAddress(pos) = (data &~ (1 << 31)); break; // 31-bit signed offset
-									default: return 8;
-								}
-								break;
-							}
-						}
-						pos++;
-					}
-				}
-			}
-		}
-	}
+	// segments which do not fit get linear heap pages of their own, the rest
+	// is written through the GSP heap
+	_3DSX_Target target = {(u32)baseAddr, (u32)dataAddr, dataSize, mapHash, getOutputBaseAddr, mapSegment, scratchSize == SCRATCHSIZE ? &pipeline : NULL};
+	ret = Load3DSXSegments(&reader, &target);
+	u32 out;
+	svc_controlMemory(&out, scratch, 0x0, scratchSize, MEMOP_FREE, 0x0);
+	if (ret)
+		return ret;
+	heap_size -= target.mappedSize;
 
 	// Detect and fill _prm structure
-	u32* prmStruct = (u32*)getActualAddress(baseAddr) + 1;
+	u32* prmStruct = (u32*)target.info.segOut[0] + 1;
 	if(prmStruct[0]==0x6D72705F)
 	{
 		// Write service handle table pointer
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <ctr/types.h>
+
+#include "reader.h"
  
 // File layout:
 // - File header
@@ -34,7 +36,25 @@ typedef struct
 	// size of the BSS section (uninitialized latter half of the data segment)
 	u32 codeSegSize, rodataSegSize, dataSegSize, bssSize;
 } _3DSX_Header;
+
+// the segments' file parts are LZ11 streams (compress/lz11_stream.h), each
+// padded to a multiple of 4 bytes; only Load3DSXSegments knows about this one,
+// and only when built with LZ11_3DSX, see host/compress3dsx.c
+#define _3DSX_FLAG_LZ11 0x1
  
+// Prelinked file: the relocated segments of a 3DSX, for one target memory map,
+// appended to it along with this at the end of its header, which host/prelink.c
+// grows by as much. Loaders which do not know about it skip it with the rest of
+// the header, and so does Load3DSXSegments when the map is not the one.
+#define _3DSX_PRELINK_MAGIC 0x4B4E4C50 // 'PLNK'
+typedef struct
+{
+	u32 magic;
+	u32 mapHash; // _3DSX_MapHash of the memorymap_t
+	u32 baseAddr, segAddrs[3]; // where the segments were relocated for
+	u32 offset, size; // of code, rodata and the loadable part of data, in a row
+} _3DSX_Prelink;
+
 // Relocation header: all fields (even extra unknown fields) are guaranteed to be relocation counts.
 typedef struct
 {
@@ -63,6 +83,54 @@ typedef struct {
     } services[];
 }service_list_t;
 
+// where Load3DSXSegments put the segments
+typedef struct
+{
+	u32 segAddrs[3]; // code, rodata & data, in the target process
+	u32 segSizes[3];
+	void* segOut[3]; // and what they were written through
+} _3DSX_LoadInfo;
+
+// a thread to read segments and relocation tables on while the ones before
+// are relocated, the relocation waiting for the words it patches to be in
+typedef struct
+{
+	// runs work(arg) on a thread of its own, until it returns and join does
+	Result (*start)(void (*work)(void* arg), void* arg);
+	void (*join)();
+	// of event 0 or 1: wakes up wait, or the next one if nothing is waiting yet
+	void (*signal)(u32 event);
+	void (*wait)(u32 event);
+	// where the tables are read ahead to, a power of 2 bytes, word aligned
+	void* buffer;
+	u32 bufferSize;
+} _3DSX_Pipeline;
+
+// where a 3DSX can go, setup3dsx's base and data region
+typedef struct
+{
+	u32 baseAddr, dataAddr, dataSize;
+	// _3DSX_MapHash of the memorymap_t, for files prelinked for it
+	u32 mapHash;
+	// what baseAddr is written through, getOutputBaseAddr on the 3DS
+	void* (*getOutput)();
+	// memory for a segment which does not fit, its address in the target
+	// process and what it is written through
+	Result (*mapSegment)(u32* addr, void** out, u32 size);
+	// NULL reads all segments before relocating any
+	const _3DSX_Pipeline* pipeline;
+	u32 mappedSize;
+	bool prelinked; // the segments were read as they are, not relocated
+	_3DSX_LoadInfo info;
+} _3DSX_Target;
+
 void* getOutputBaseAddr();
 
-int Load3DSX(Handle file, void* baseAddr, void* dataAddr, u32 dataSize, service_list_t* __service_ptr, u32* argbuf);
+// reads and relocates, in 3dsx_load.c so that it builds on the host
+int Load3DSXSegments(reader_t* reader, _3DSX_Target* target);
+// of a memorymap_t, only of what says where things go: its header up to
+// processLinearOffset and its entries, as the rest, like the region's TID low,
+// differs between the host's copy of a map and the 3DS's
+u32 _3DSX_MapHash(const void* layout, u32 layoutSize, const void* entries, u32 entriesSize);
+
+int Load3DSX(Handle file, void* baseAddr, void* dataAddr, u32 dataSize, u32 mapHash, service_list_t* __service_ptr, u32* argbuf);
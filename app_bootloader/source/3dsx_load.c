@@ -0,0 +1,509 @@
+#include <stddef.h>
+#include <string.h>
+#include <ctr/types.h>
+
+#include "3dsx.h"
+#include "reader.h"
+#ifdef LZ11_3DSX
+#include "../../compress/lz11_stream.h"
+#endif
+
+// Load3DSX's reading and relocating, apart from what is particular to the 3DS
+// so that it builds on the host too. Addresses are the target process's, the
+// segments are written through what _3DSX_Target gives for them.
+
+//code by fincs
+
+#define SEC_ASSERT(x) if(!(x)) return 0x5ECDEAD
+
+static inline u32 TranslateAddr(u32 addr, _3DSX_LoadInfo* d, u32* offsets)
+{
+	if (addr < offsets[0])
+		return d->segAddrs[0] + addr;
+	if (addr < offsets[1])
+		return d->segAddrs[1] + addr - offsets[0];
+	return d->segAddrs[2] + addr - offsets[1];
+}
+
+// a segment's file part, decoded straight into out as it comes in for
+// _3DSX_FLAG_LZ11 files
+static int ReadSegment(reader_t* reader, u32 flags, void* out, u32 size)
+{
+	if (!(flags & _3DSX_FLAG_LZ11))
+		return readerRead(reader, out, size);
+
+#ifdef LZ11_3DSX
+	lz11_stream_t s;
+	lz11_stream_init(&s, NULL, 0);
+	u32 done = 0;
+	for (;;)
+	{
+		const u8* in;
+		u32 available = readerNext(reader, (const void**)&in, 1, ~0);
+		if (!available)
+			return -1;
+
+		u32 used = available, decoded = size - done;
+		int ret = lz11_stream_decode(&s, in, &used, (u8*)out + done, &decoded);
+		done += decoded;
+		// give back what the stream did not use
+		readerSeek(reader, reader->offset - (available - used));
+
+		if (ret == LZ11_STREAM_ERROR || (s.state != LZ11_STREAM_HEADER && s.size != size))
+			return -1;
+		if (ret == LZ11_STREAM_DONE)
+			break;
+		if (!used && !decoded)
+			return -1;
+	}
+
+	readerSeek(reader, (reader->offset + 3) &~ 3);
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+// what is read on the pipeline's thread: the segments, and the relocation
+// tables ahead of relocating, into the pipeline's buffer as it frees it
+typedef struct
+{
+	const _3DSX_Pipeline* pipeline;
+	reader_t reader; // unbuffered
+	void* out[3];
+	u32 size[3];
+	u64 offset[3];
+	u32 done[3]; // bytes read of each
+	u64 tablesOffset;
+	u32 tablesSize;
+	// bytes of the tables read, and those before the relocating's batch
+	u32 tablesIn, tablesFree;
+	u32 tablesPos; // and after it
+	u32 finished;
+	u32 cancelled; // no more tables wanted
+	int result;
+} _3DSX_Pipe;
+
+// the counts above which the other thread reads, stored once what they count
+// is in (or, for tablesFree, done with) and loaded before looking at it
+static inline u32 PipeLoad(const u32* count)
+{
+#ifdef __arm__
+	// on the 3DS the pipeline's thread is on the loader's core, so the compiler
+	// is all there is to keep from reordering; an acquire would also make armv6
+	// thumb code call into libgcc, which the loader is linked without
+	u32 value = __atomic_load_n(count, __ATOMIC_RELAXED);
+	__asm__ volatile("" ::: "memory");
+	return value;
+#else
+	return __atomic_load_n(count, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void PipeStore(u32* count, u32 value)
+{
+#ifdef __arm__
+	__asm__ volatile("" ::: "memory");
+	__atomic_store_n(count, value, __ATOMIC_RELAXED);
+#else
+	__atomic_store_n(count, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// events: something was read, and relocating freed some of the buffer
+#define PIPE_READ 0
+#define PIPE_FREED 1
+
+// a segment is read in chunks of twice the size of the one before, from this
+// on and up to the other: relocating starts early, there are few more reads
+// than without, and the tables get read between them
+#define PIPELINE_CHUNK 0x20000
+#define PIPELINE_MAXCHUNK 0x80000
+
+static void ReadAhead(void* arg)
+{
+	_3DSX_Pipe* p = arg;
+	u8* buffer = p->pipeline->buffer;
+	u32 bufferSize = p->pipeline->bufferSize;
+	u32 i = 0, chunk = PIPELINE_CHUNK;
+	while (!p->result)
+	{
+		// the tables in halves of the buffer, ahead of the segments as
+		// relocating can't do anything without them, until it is over
+		u32 in = p->tablesIn;
+		u32 n = PipeLoad(&p->cancelled) ? 0 : p->tablesSize - in;
+		if (n > bufferSize/2)
+			n = bufferSize/2;
+		u32 freed = PipeLoad(&p->tablesFree);
+		if (n && in + n - freed <= bufferSize)
+		{
+			readerSeek(&p->reader, p->tablesOffset + in);
+			if (readerRead(&p->reader, buffer + (in & (bufferSize - 1)), n) != 0)
+			{
+				p->result = -7;
+				break;
+			}
+			PipeStore(&p->tablesIn, in + n);
+		}
+		else if (i < 3)
+		{
+			u32 done = p->done[i];
+			if (done == p->size[i])
+			{
+				i ++;
+				chunk = PIPELINE_CHUNK;
+				continue;
+			}
+			n = p->size[i] - done;
+			if (n > chunk)
+				n = chunk;
+			if (chunk < PIPELINE_MAXCHUNK)
+				chunk *= 2;
+			readerSeek(&p->reader, p->offset[i] + done);
+			if (readerRead(&p->reader, (u8*)p->out[i] + done, n) != 0)
+			{
+				p->result = -4 - i;
+				break;
+			}
+			PipeStore(&p->done[i], done + n);
+		}
+		else if (n)
+		{
+			p->pipeline->wait(PIPE_FREED);
+			continue;
+		}
+		else
+			break;
+		p->pipeline->signal(PIPE_READ);
+	}
+	PipeStore(&p->finished, 1);
+	p->pipeline->signal(PIPE_READ);
+}
+
+// how much of segment i is in once need bytes are, or the reading is over
+static u32 WaitSegment(_3DSX_Pipe* p, u32 i, u32 need)
+{
+	for (;;)
+	{
+		u32 finished = PipeLoad(&p->finished);
+		u32 done = PipeLoad(&p->done[i]);
+		if (done >= need || finished)
+			return done;
+		p->pipeline->wait(PIPE_READ);
+	}
+}
+
+// the next batch of relocation table entries, maxCount at most, straight
+// from the reader's buffer or from what the pipeline read ahead
+static u32 NextRelocs(reader_t* reader, _3DSX_Pipe* p, const _3DSX_Reloc** relocTbl, u32 maxCount)
+{
+	if (!p)
+		return readerNext(reader, (const void**)relocTbl, sizeof(_3DSX_Reloc), maxCount);
+
+	// done with the batch before
+	u32 pos = p->tablesPos;
+	if (p->tablesFree != pos)
+	{
+		PipeStore(&p->tablesFree, pos);
+		p->pipeline->signal(PIPE_FREED);
+	}
+
+	u32 in;
+	for (;;)
+	{
+		u32 finished = PipeLoad(&p->finished);
+		in = PipeLoad(&p->tablesIn);
+		if (in > pos)
+			break;
+		if (finished)
+			return 0;
+		p->pipeline->wait(PIPE_READ);
+	}
+
+	// entries don't straddle the end of the buffer, as it is a power of 2
+	u32 bufferSize = p->pipeline->bufferSize;
+	u32 n = in - pos;
+	if (n > bufferSize - (pos & (bufferSize - 1)))
+		n = bufferSize - (pos & (bufferSize - 1));
+	n /= sizeof(_3DSX_Reloc);
+	if (n > maxCount)
+		n = maxCount;
+	*relocTbl = (const _3DSX_Reloc*)((u8*)p->pipeline->buffer + (pos & (bufferSize - 1)));
+	p->tablesPos = pos + n*sizeof(_3DSX_Reloc);
+	return n;
+}
+
+// Relocate the segments
+static int RelocateSegments(reader_t* reader, _3DSX_LoadInfo* d, u32* offsets, u32* relocs, u32 nRelocTables, u32* fileSizes, _3DSX_Pipe* pipe)
+{
+	u32 i, j, k, m;
+
+	for (i = 0; i < 3; i ++)
+	{
+		for (j = 0; j < nRelocTables; j ++)
+		{
+			u32 nRelocs = relocs[i*nRelocTables+j];
+			if (j >= 2)
+			{
+				// We are not using this table - ignore it
+				if (!pipe)
+					readerSkip(reader, (u64)nRelocs*sizeof(_3DSX_Reloc));
+				while (pipe && nRelocs)
+				{
+					const _3DSX_Reloc* relocTbl;
+					u32 toDo = NextRelocs(reader, pipe, &relocTbl, nRelocs);
+					if (!toDo)
+						return -7;
+					nRelocs -= toDo;
+				}
+				continue;
+			}
+
+			// word indices into the segment, which is written through out
+			u32* out = d->segOut[i];
+			u32 pos = 0;
+			u32 endPos = d->segSizes[i]/4;
+			// bytes of it which are in
+			u32 available = pipe ? 0 : ~0;
+
+			while (nRelocs)
+			{
+				const _3DSX_Reloc* relocTbl;
+				u32 toDo = NextRelocs(reader, pipe, &relocTbl, nRelocs);
+				if (!toDo)
+					return -7;
+				nRelocs -= toDo;
+
+				for (k = 0; k < toDo && pos < endPos; k ++)
+				{
+					pos += relocTbl[k].skip;
+					u32 num_patches = relocTbl[k].patch;
+					for (m = 0; m < num_patches && pos < endPos; m ++)
+					{
+						if (pos*4 + 4 > available && pos*4 < fileSizes[i])
+						{
+							u32 need = pos*4 + 4 < fileSizes[i] ? pos*4 + 4 : fileSizes[i];
+							if ((available = WaitSegment(pipe, i, need)) < need)
+								return -4 - i;
+						}
+
+						u32 origData = out[pos];
+						u32 subType = origData >> (32-4);
+						u32 addr = TranslateAddr(origData &~ 0xF0000000, d, offsets);
+
+						switch (j)
+						{
+							case 0:
+							{
+								if (subType != 0)
+									return 7;
+								out[pos] = addr;
+								break;
+							}
+							case 1:
+							{
+								u32 data = addr - (d->segAddrs[i] + pos*4);
+								switch (subType)
+								{
+									case 0: out[pos] = (data);            break; // 32-bit signed offset
+									case 1: out[pos] = (data &~ (1 << 31)); break; // 31-bit signed offset
+									default: return 8;
+								}
+								break;
+							}
+						}
+						pos++;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+int Load3DSXSegments(reader_t* reader, _3DSX_Target* t)
+{
+	u32 i;
+	_3DSX_LoadInfo* d = &t->info;
+
+	SEC_ASSERT(t->baseAddr >= 0x00100000);
+	SEC_ASSERT((t->baseAddr & 0xFFF) == 0); // page alignment
+
+	_3DSX_Header hdr;
+	if (readerRead(reader, &hdr, sizeof(hdr)) != 0)
+		return -1;
+
+	if (hdr.magic != _3DSX_MAGIC)
+		return -2;
+#ifndef LZ11_3DSX
+	// the decoder only gets in with LZ11_3DSX, it does not fit in the
+	// bootloader next to everything else otherwise
+	if (hdr.flags & _3DSX_FLAG_LZ11)
+		return -2;
+#endif
+	SEC_ASSERT(hdr.dataSegSize >= hdr.bssSize); // int underflow
+
+	// prelinked for this target ?
+	_3DSX_Prelink prelink;
+	bool prelinked = false;
+	if (hdr.headerSize >= sizeof(hdr) + sizeof(prelink))
+	{
+		readerSeek(reader, hdr.headerSize - sizeof(prelink));
+		if (readerRead(reader, &prelink, sizeof(prelink)) != 0)
+			return -1;
+		prelinked = prelink.magic == _3DSX_PRELINK_MAGIC && prelink.mapHash == t->mapHash && prelink.baseAddr == t->baseAddr
+			&& prelink.size == hdr.codeSegSize + hdr.rodataSegSize + hdr.dataSegSize - hdr.bssSize;
+	}
+
+	d->segSizes[0] = (hdr.codeSegSize+0xFFF) &~ 0xFFF;
+	SEC_ASSERT(d->segSizes[0] >= hdr.codeSegSize); // int overflow
+	d->segSizes[1] = (hdr.rodataSegSize+0xFFF) &~ 0xFFF;
+	SEC_ASSERT(d->segSizes[1] >= hdr.rodataSegSize); // int overflow
+	d->segSizes[2] = (hdr.dataSegSize+0xFFF) &~ 0xFFF;
+	SEC_ASSERT(d->segSizes[2] >= hdr.dataSegSize); // int overflow
+
+	u32 offsets[2] = { d->segSizes[0], d->segSizes[0] + d->segSizes[1] };
+	d->segAddrs[0] = t->baseAddr;
+	d->segAddrs[1] = d->segAddrs[0] + d->segSizes[0];
+	SEC_ASSERT(d->segAddrs[1] >= d->segSizes[0]); // int overflow
+	d->segAddrs[2] = d->segAddrs[1] + d->segSizes[1];
+	SEC_ASSERT(d->segAddrs[2] >= d->segSizes[1]); // int overflow
+
+	void* mapped[3] = {NULL, NULL, NULL};
+
+	// not enough room for rodata/data ? no problem dawg
+	bool mapRodata = (d->segAddrs[1] >= t->dataAddr + t->dataSize) || d->segSizes[1] > t->dataAddr + t->dataSize - d->segAddrs[1];
+
+	if(d->segAddrs[2] < t->dataAddr)d->segAddrs[2] = t->dataAddr;
+
+	bool mapData = (d->segAddrs[2] >= t->dataAddr + t->dataSize) || (hdr.dataSegSize > t->dataSize - (d->segAddrs[2] - t->dataAddr));
+
+	// mapped segments' addresses are only known now, so a prelinked file can only
+	// have been linked for where the rest go
+	t->prelinked = prelinked && !mapRodata && !mapData && prelink.segAddrs[0] == d->segAddrs[0]
+		&& prelink.segAddrs[1] == d->segAddrs[1] && prelink.segAddrs[2] == d->segAddrs[2];
+
+	if (mapRodata)
+	{
+		// no room for rodata
+		if (t->mapSegment(&d->segAddrs[1], &mapped[1], d->segSizes[1]) != 0)
+			return -9;
+		t->mappedSize += d->segSizes[1];
+	}
+
+	if (mapData)
+	{
+		// no room for data
+		if (t->mapSegment(&d->segAddrs[2], &mapped[2], d->segSizes[2]) != 0)
+			return -9;
+		t->mappedSize += d->segSizes[2];
+	}
+
+	u8* output = t->getOutput();
+	for (i = 0; i < 3; i ++)
+		d->segOut[i] = mapped[i] ? mapped[i] : output + d->segAddrs[i] - t->baseAddr;
+
+	if (t->prelinked)
+	{
+		// straight to where they go, nothing to relocate
+		readerSeek(reader, prelink.offset);
+		if (readerRead(reader, d->segOut[0], hdr.codeSegSize) != 0) return -4;
+		if (readerRead(reader, d->segOut[1], hdr.rodataSegSize) != 0) return -5;
+		if (readerRead(reader, d->segOut[2], hdr.dataSegSize - hdr.bssSize) != 0) return -6;
+		return 0;
+	}
+
+	// Skip header for future compatibility.
+	readerSeek(reader, hdr.headerSize);
+
+	// Read the relocation headers
+	u32 relocsAddr = d->segAddrs[2] + hdr.dataSegSize - hdr.bssSize;
+	SEC_ASSERT(relocsAddr >= d->segAddrs[2]); // int overflow
+	u32 nRelocTables = hdr.relocHdrSize/4;
+
+	u32 relocsEnd = relocsAddr + 3*nRelocTables*4;
+	SEC_ASSERT(relocsEnd >= relocsAddr); // int overflow
+
+	u32* relocs = (u32*)((u8*)d->segOut[2] + hdr.dataSegSize - hdr.bssSize);
+
+	// XXX: Ensure enough RW pages exist at baseAddr to hold a memory block of length "totalSize".
+	//    This also checks whether the memory region overflows into IPC data or loader data.
+
+	for (i = 0; i < 3; i ++)
+		if (readerRead(reader, &relocs[i*nRelocTables], nRelocTables*4) != 0)
+			return -3;
+
+	// Read the segments, the relocation tables after them are read as they are
+	// walked; with a pipeline, both are read on its thread as relocating goes
+	u32 fileSizes[3] = { hdr.codeSegSize, hdr.rodataSegSize, hdr.dataSegSize - hdr.bssSize };
+	u64 tablesSize = 0;
+	for (i = 0; i < 3*nRelocTables; i ++)
+		tablesSize += (u64)relocs[i]*sizeof(_3DSX_Reloc);
+	_3DSX_Pipe pipe;
+	bool pipelined = t->pipeline && !(hdr.flags & _3DSX_FLAG_LZ11) && tablesSize <= 0xFFFFFFFF;
+	if (pipelined)
+	{
+		memset(&pipe, 0, sizeof(pipe));
+		pipe.pipeline = t->pipeline;
+		u64 segmentsOffset = reader->offset;
+		for (i = 0; i < 3; i ++)
+		{
+			pipe.out[i] = d->segOut[i];
+			pipe.size[i] = fileSizes[i];
+			pipe.offset[i] = reader->offset;
+			// what the header's read brought in already
+			u32 n = readerAvailable(reader);
+			pipe.done[i] = n < fileSizes[i] ? n : fileSizes[i];
+			if (readerRead(reader, d->segOut[i], pipe.done[i]) != 0)
+				return -4 - i;
+			readerSkip(reader, fileSizes[i] - pipe.done[i]);
+		}
+		pipe.tablesOffset = reader->offset;
+		pipe.tablesSize = tablesSize;
+		readerInit(&pipe.reader, reader->backend, NULL, 0);
+		if (t->pipeline->start(ReadAhead, &pipe) != 0)
+		{
+			readerSeek(reader, segmentsOffset);
+			pipelined = false;
+		}
+	}
+
+	if (!pipelined)
+	{
+		if (ReadSegment(reader, hdr.flags, d->segOut[0], fileSizes[0]) != 0) return -4;
+		if (ReadSegment(reader, hdr.flags, d->segOut[1], fileSizes[1]) != 0) return -5;
+		if (ReadSegment(reader, hdr.flags, d->segOut[2], fileSizes[2]) != 0) return -6;
+	}
+
+	int ret = RelocateSegments(reader, d, offsets, relocs, nRelocTables, fileSizes, pipelined ? &pipe : NULL);
+
+	if (pipelined)
+	{
+		// relocating may have stopped short of the tables' end
+		PipeStore(&pipe.cancelled, 1);
+		t->pipeline->signal(PIPE_FREED);
+		t->pipeline->join();
+		reader->numReads += pipe.reader.numReads;
+		reader->bytesRead += pipe.reader.bytesRead;
+		// a failed read is why relocating stopped
+		if (pipe.result)
+			ret = pipe.result;
+	}
+
+	return ret;
+}
+
+static u32 fnv1a(u32 hash, const void* data, u32 size)
+{
+	const u8* p = data;
+	while (size--)
+		hash = (hash ^ *p++) * 0x01000193;
+	return hash;
+}
+
+// FNV-1a, over the layout and then the entries
+u32 _3DSX_MapHash(const void* layout, u32 layoutSize, const void* entries, u32 entriesSize)
+{
+	return fnv1a(fnv1a(0x811C9DC5, layout, layoutSize), entries, entriesSize);
+}
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctr/types.h>
@@ -210,7 +211,8 @@ void setup3dsx(Handle executable, memorymap_t* m, service_list_t* serviceList, u
 {
 	if(!m)return;
 
-	Result ret = Load3DSX(executable, (void*)(0x00100000 + 0x00008000), (void*)m->header.data_address, m->header.data_size, serviceList, argbuf);
+	u32 mapHash = _3DSX_MapHash(&m->header, offsetof(memorymap_header_t, processLinearOffset), m->map, sizeof(memorymap_entry_t) * m->header.num);
+	Result ret = Load3DSX(executable, (void*)(0x00100000 + 0x00008000), (void*)m->header.data_address, m->header.data_size, mapHash, serviceList, argbuf);
 
 	apply_map(m);
 
@@ -0,0 +1,101 @@
+#include <string.h>
+#include <ctr/types.h>
+
+#include "reader.h"
+
+void readerInit(reader_t* r, reader_backend_t backend, void* buffer, u32 bufferSize)
+{
+	r->backend = backend;
+	r->buffer = buffer;
+	r->bufferSize = bufferSize;
+	r->bufferOffset = 0;
+	r->bufferLength = 0;
+	r->offset = 0;
+	r->numReads = 0;
+	r->bytesRead = 0;
+}
+
+void readerSeek(reader_t* r, u64 offset)
+{
+	r->offset = offset;
+}
+
+void readerSkip(reader_t* r, u64 size)
+{
+	r->offset += size;
+}
+
+static Result readerBackendRead(reader_t* r, u64 offset, void* dst, u32 size, u32* bytesRead)
+{
+	*bytesRead = 0;
+	Result ret = r->backend.read(r->backend.file, offset, dst, size, bytesRead);
+	r->numReads++;
+	r->bytesRead += *bytesRead;
+	return ret;
+}
+
+static Result readerFill(reader_t* r)
+{
+	u64 start = (r->offset & ~(u64)(READER_ALIGN - 1)) | (r->offset & 3);
+	u32 bytesRead;
+	Result ret = readerBackendRead(r, start, r->buffer, r->bufferSize, &bytesRead);
+	r->bufferOffset = start;
+	r->bufferLength = ret ? 0 : bytesRead;
+	return ret;
+}
+
+// bytes from offset on that are in the buffer
+static u32 readerBuffered(reader_t* r)
+{
+	if(r->offset < r->bufferOffset || r->offset >= r->bufferOffset + r->bufferLength) return 0;
+	return r->bufferOffset + r->bufferLength - r->offset;
+}
+
+u32 readerAvailable(reader_t* r)
+{
+	return readerBuffered(r);
+}
+
+int readerRead(reader_t* r, void* dst, u32 size)
+{
+	u8* out = dst;
+	while(size)
+	{
+		u32 n = readerBuffered(r);
+		if(n)
+		{
+			if(n > size) n = size;
+			memcpy(out, &r->buffer[r->offset - r->bufferOffset], n);
+			out += n;
+			size -= n;
+			r->offset += n;
+		}else if(size >= r->bufferSize)
+		{
+			u32 bytesRead;
+			Result ret = readerBackendRead(r, r->offset, out, size, &bytesRead);
+			if(ret) return ret;
+			r->offset += bytesRead;
+			return (bytesRead == size) ? 0 : -1;
+		}else{
+			Result ret = readerFill(r);
+			if(ret) return ret;
+			if(!readerBuffered(r)) return -1;
+		}
+	}
+	return 0;
+}
+
+u32 readerNext(reader_t* r, const void** ptr, u32 elementSize, u32 maxCount)
+{
+	u32 n = readerBuffered(r);
+	if(n < elementSize || (!(elementSize & 3) && ((r->offset - r->bufferOffset) & 3)))
+	{
+		if(readerFill(r)) return 0;
+		n = readerBuffered(r);
+	}
+	n /= elementSize;
+	if(n > maxCount) n = maxCount;
+	*ptr = &r->buffer[r->offset - r->bufferOffset];
+	r->offset += n * elementSize;
+	return n;
+}
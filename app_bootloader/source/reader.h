@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ctr/types.h>
+
+// Buffered reads for Load3DSX. Each FSFILE_Read is an IPC, so reads go
+// through a buffer filled a large block at a time from aligned offsets, reads
+// at least as large as the buffer (segments) go straight to their
+// destination, and relocations are walked in place in the buffer.
+
+typedef struct
+{
+	// reads size bytes at offset into dst, less at the end of the file
+	Result (*read)(void* file, u64 offset, void* dst, u32 size, u32* bytesRead);
+	void* file;
+} reader_backend_t;
+
+// buffer fills start on such a boundary (plus the offset's low 2 bits, so
+// that what readerNext returns is word aligned)
+#define READER_ALIGN 0x200
+
+typedef struct
+{
+	reader_backend_t backend;
+	u8* buffer;
+	u32 bufferSize;
+	u64 bufferOffset; // file offset of buffer[0]
+	u32 bufferLength;
+	u64 offset; // of the next read
+	u32 numReads; // backend reads so far
+	u64 bytesRead; // and what they returned
+} reader_t;
+
+// bufferSize 0 makes every read a backend read, readerNext needs a buffer
+void readerInit(reader_t* r, reader_backend_t backend, void* buffer, u32 bufferSize);
+void readerSeek(reader_t* r, u64 offset);
+void readerSkip(reader_t* r, u64 size);
+int readerRead(reader_t* r, void* dst, u32 size);
+// bytes from the offset on which reads take from the buffer
+u32 readerAvailable(reader_t* r);
+// points *ptr at up to maxCount elements in the buffer and moves past them,
+// returns how many, 0 at the end of the file or on error; elements of a
+// multiple of 4 bytes are word aligned
+u32 readerNext(reader_t* r, const void** ptr, u32 elementSize, u32 maxCount);
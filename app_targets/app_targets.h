@@ -187,68 +187,74 @@ static const memorymap_t * const app_maps[] =
 // this way i only need to have the define in one location instead of #ifdefs everywhere
 static const int numTargetProcesses = 4 + IS_N3DS;
 
-static void patchPayload(u32* payload_dst, int targetProcessIndex, memorymap_t* mmap)
+// the build leaves a table of where the ropbin's aliases are at the end of
+// it, see scripts/ropRelocs.py
+#define ROPBIN_SIZE 0x8000
+#define ROPBIN_RELOCS_MAGIC 0x434C5242
+
+static int patchPayload(u32* payload_dst, int targetProcessIndex, memorymap_t* mmap)
 {
 	if(!mmap) mmap = (memorymap_t*)app_maps[targetProcessIndex];
+	if(payload_dst[ROPBIN_SIZE / 4 - 1] != ROPBIN_RELOCS_MAGIC) return -1;
+	const u32* relocs = &payload_dst[payload_dst[ROPBIN_SIZE / 4 - 2] / 4];
+	const u32 num_relocs = relocs[0];
 	// payload has a bunch of aliases to handle multiple target processes "gracefully"
-	int i;
-	for(i = 0; i < 0x10000 / 4; i++)
+	u32 j;
+	for(j = 0; j < num_relocs; j++)
 	{
-		u32 val = payload_dst[i];
-		if(val >> 16 == 0xBABE)
-		{
-			val &= 0xFFFF;
-				// target process index
-				if(val == 0x0001)
-				{
-					payload_dst[i] = targetProcessIndex;
-				}
-				// target process APP_START_LINEAR
-				else if(val == 0x0002)
-				{
-					payload_dst[i] = 0x30000000 + FIRM_APPMEMALLOC - mmap->header.processLinearOffset;
-				}
-				// target process hook virtual address
-				else if(val == 0x0003)
-				{
-					payload_dst[i] = mmap->header.processHookAddress;
-				}
-				// target process TID low (for nss_launchtitle)
-				else if(val == 0x0004)
-				{
-					if(mmap->header.mediatype == 2) payload_dst[i] = 0;
-					else payload_dst[i] = mmap->header.processHookTidLow;
-				}
-				// target process TID high (for nss_launchtitle)
-				else if(val == 0x0005)
-				{
-					if(mmap->header.mediatype == 2) payload_dst[i] = 0;
-					else payload_dst[i] = mmap->header.processHookTidHigh;
-				}
-				// cur process map
-				else if(val == 0x0006)
-				{
-					memcpy(&payload_dst[i], mmap, sizeof(memorymap_header_t) + sizeof(memorymap_entry_t) * mmap->header.num);
-				}
-				// app_code base address
-				else if(val == 0x0007)
-				{
-					payload_dst[i] = mmap->header.processAppCodeAddress;
-				}
-				// target process TID low (for things other than nss_launchtitle)
-				else if(val == 0x0008)
-				{
-					payload_dst[i] = mmap->header.processHookTidLow & ~0x20000000; // mask for nss_terminate
-				}
-				// target process TID high (for things other than nss_launchtitle)
-				else if(val == 0x0009)
-				{
-					payload_dst[i] = mmap->header.processHookTidHigh;
-				}
-				else if(val == 0x000A)
-				{
-					payload_dst[i] = mmap->header.mediatype;
-				}
+		int i = relocs[1 + j] >> 16;
+		u32 val = relocs[1 + j] & 0xFFFF;
+		// target process index
+		if(val == 0x0001)
+		{
+			payload_dst[i] = targetProcessIndex;
+		}
+		// target process APP_START_LINEAR
+		else if(val == 0x0002)
+		{
+			payload_dst[i] = 0x30000000 + FIRM_APPMEMALLOC - mmap->header.processLinearOffset;
+		}
+		// target process hook virtual address
+		else if(val == 0x0003)
+		{
+			payload_dst[i] = mmap->header.processHookAddress;
+		}
+		// target process TID low (for nss_launchtitle)
+		else if(val == 0x0004)
+		{
+			if(mmap->header.mediatype == 2) payload_dst[i] = 0;
+			else payload_dst[i] = mmap->header.processHookTidLow;
+		}
+		// target process TID high (for nss_launchtitle)
+		else if(val == 0x0005)
+		{
+			if(mmap->header.mediatype == 2) payload_dst[i] = 0;
+			else payload_dst[i] = mmap->header.processHookTidHigh;
+		}
+		// cur process map
+		else if(val == 0x0006)
+		{
+			memcpy(&payload_dst[i], mmap, sizeof(memorymap_header_t) + sizeof(memorymap_entry_t) * mmap->header.num);
+		}
+		// app_code base address
+		else if(val == 0x0007)
+		{
+			payload_dst[i] = mmap->header.processAppCodeAddress;
+		}
+		// target process TID low (for things other than nss_launchtitle)
+		else if(val == 0x0008)
+		{
+			payload_dst[i] = mmap->header.processHookTidLow & ~0x20000000; // mask for nss_terminate
+		}
+		// target process TID high (for things other than nss_launchtitle)
+		else if(val == 0x0009)
+		{
+			payload_dst[i] = mmap->header.processHookTidHigh;
+		}
+		else if(val == 0x000A)
+		{
+			payload_dst[i] = mmap->header.mediatype;
 		}
 	}
+	return 0;
 }
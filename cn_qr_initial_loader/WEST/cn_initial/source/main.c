@@ -7,7 +7,10 @@
 #include "text.h"
 
 #include "../../../../build/constants.h"
-#include "decomp.h"
+#include "../../../../compress/lz11_stream.h"
+
+#define HTTPC_DOWNLOAD_PENDING 0xD840A02B
+#define PAYLOAD_CHUNK_SIZE 0x8000
 
 #define TOPFBADR1 ((u8*)CN_TOPFBADR1)
 #define TOPFBADR2 ((u8*)CN_TOPFBADR2)
@@ -128,7 +131,7 @@ Result HTTPC_ReceiveData(Handle handle, Handle contextHandle, u8* buffer, u32 si
 	return cmdbuf[1];
 }
 
-Result HTTPC_GetDownloadSizeState(Handle handle, Handle contextHandle, u32* totalSize)
+Result HTTPC_GetDownloadSizeState(Handle handle, Handle contextHandle, u32* downloadedSize, u32* totalSize)
 {
 	u32* cmdbuf=getThreadCommandBuffer();
 
@@ -138,6 +141,7 @@ Result HTTPC_GetDownloadSizeState(Handle handle, Handle contextHandle, u32* tota
 	Result ret=0;
 	if((ret=svc_sendSyncRequest(handle)))return ret;
 
+	if(downloadedSize)*downloadedSize=cmdbuf[2];
 	if(totalSize)*totalSize=cmdbuf[3];
 
 	return cmdbuf[1];
@@ -316,31 +320,59 @@ int _main()
 
 	// drawHex(ret,0,line+=10);
 
-	u8* buffer0=(u8*)0x14100000;
-	u8* buffer1=(u8*)0x14300000;
+	u8* buffer0=(u8*)0x14100000; // decompressed payload
+	u8* buffer1=(u8*)0x14300000; // decrypted payload, which the installer saves as is
+	u8* buffer2=(u8*)0x14280000; // chunk being received
 	u32 secondaryPayloadSize=0x0;
-	ret=HTTPC_ReceiveData(httpcHandle2, httpContextHandle, buffer0, 0x300000);
-	if(ret)*(u32*)NULL=0xC0DE0005;
-	ret=HTTPC_GetDownloadSizeState(httpcHandle2, httpContextHandle, &secondaryPayloadSize);
-	if(ret)*(u32*)NULL=0xC0DE0006;
-
-	// drawHex(ret,0,line+=10);
-
-	HTTPC_CloseContext(httpcHandle2, httpContextHandle);
-	if(ret)*(u32*)NULL=0xC0DE0007;
 
 	//TODO : modify key/parray first ?
 	//(use some of its slots as variables in ROP to confuse people ?)
-	//decrypt secondary payload
 	Result (*blowfishKeyScheduler)(u32* dst)=(void*)0x001A44BC;
 	Result (*blowfishDecrypt)(u32* blowfishKeyData, u32* src, u32* dst, u32 size)=(void*)0x001A4B04;
 
 	blowfishKeyScheduler((u32*)0x14200000);
-	blowfishDecrypt((u32*)0x14200000, (u32*)buffer0, (u32*)buffer1, secondaryPayloadSize);
 
-	while(!*(u32*)(&buffer1[secondaryPayloadSize-4]))secondaryPayloadSize-=4;
+	//receive, decrypt and decompress the secondary payload a chunk at a time
+	//so that decryption and decompression overlap with the download
+	lz11_stream_t stream;
+	lz11_stream_init(&stream, NULL, 0);
 
-	lzss_decompress(buffer1, secondaryPayloadSize, buffer0, lzss_get_decompressed_size(buffer1, secondaryPayloadSize));
+	u32 received=0, pending=0, consumed=0, decompressed=0;
+	int status=LZ11_STREAM_MORE;
+	do
+	{
+		u32 downloaded=received;
+		ret=HTTPC_ReceiveData(httpcHandle2, httpContextHandle, &buffer2[pending], PAYLOAD_CHUNK_SIZE);
+		if(ret && ret!=HTTPC_DOWNLOAD_PENDING)*(u32*)NULL=0xC0DE0005;
+		if(HTTPC_GetDownloadSizeState(httpcHandle2, httpContextHandle, &downloaded, NULL))*(u32*)NULL=0xC0DE0006;
+
+		pending+=downloaded-received;
+		received=downloaded;
+
+		//blowfish works on whole 8 byte blocks, keep the rest for later
+		u32 size=pending&~7;
+		if(size)blowfishDecrypt((u32*)0x14200000, (u32*)buffer2, (u32*)&buffer1[secondaryPayloadSize], size);
+
+		u32 i;
+		for(i=0; i<pending-size; i++)buffer2[i]=buffer2[size+i];
+		pending-=size;
+		secondaryPayloadSize+=size;
+
+		if(status==LZ11_STREAM_MORE)
+		{
+			//output must stay clear of the key data
+			u32 srclen=secondaryPayloadSize-consumed, dstlen=0x00100000-decompressed;
+			status=lz11_stream_decode(&stream, &buffer1[consumed], &srclen, &buffer0[decompressed], &dstlen);
+			consumed+=srclen;
+			decompressed+=dstlen;
+		}
+	}while(ret==HTTPC_DOWNLOAD_PENDING);
+
+	if(status!=LZ11_STREAM_DONE)*(u32*)NULL=0xC0DE0008;
+
+	// drawHex(ret,0,line+=10);
+
+	HTTPC_CloseContext(httpcHandle2, httpContextHandle);
 
 	ret=_GSPGPU_FlushDataCache(gspHandle, 0xFFFF8001, (u32*)buffer0, 0x300000);
 	// drawHex(ret,0,line+=10);
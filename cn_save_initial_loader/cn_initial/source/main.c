@@ -7,7 +7,7 @@
 #include "text.h"
 
 #include "../../../build/constants.h"
-#include "decomp.h"
+#include "../../../compress/lz11_stream.h"
 
 int _strlen(char* str)
 {
@@ -272,7 +272,10 @@ int _main()
 	#ifndef QRINSTALLER
 	//decompress it
 	{
-		lzss_decompress((u8*)0x14300000, secondaryPayloadSize, (u8*)0x14100000, lzss_get_decompressed_size((u8*)0x14300000, secondaryPayloadSize));
+		lz11_stream_t stream;
+		u32 dstlen=0x00100000;
+		lz11_stream_init(&stream, NULL, 0);
+		if(lz11_stream_decode(&stream, (u8*)0x14300000, &secondaryPayloadSize, (u8*)0x14100000, &dstlen)!=LZ11_STREAM_DONE)*(u32*)NULL=0xC0DF0005;
 	}
 	#else
 		memcpy((u8*)0x14100000, (u8*)0x14300000, secondaryPayloadSize);
@@ -0,0 +1,6 @@
+#include "decompress.h"
+#include "../../compress/huff.h"
+
+void huffDecompress(const u8 *src, u8 *dst, int size, int bits) {
+  huff_decode(src, dst, size, bits);
+}
@@ -0,0 +1,7 @@
+#include "decompress.h"
+#include "../../compress/lzss_fast.h"
+
+void lzssDecompress(const u8 *src, u8 *dst, int size) {
+  // word-wide copies for literal runs, fills and matches; see lzss_fast.h
+  lzss_decode_fast(src, dst, size);
+}
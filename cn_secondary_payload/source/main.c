@@ -10,8 +10,10 @@
 #include "text.h"
 #ifndef LOADROPBIN
 #include "menu_payload_regionfree_bin.h"
+#include "menu_payload_regionfree_relocs_bin.h"
 #else
 #include "menu_payload_loadropbin_bin.h"
+#include "menu_payload_loadropbin_relocs_bin.h"
 #endif
 
 #ifndef OTHERAPP
@@ -24,6 +26,10 @@
 #include "menu_ropbin_bin.h"
 #endif
 
+#ifdef MULTIMENU
+#include "menu_slots_bin.h"
+#endif
+
 #include "../../build/constants.h"
 #include "../../app_targets/app_targets.h"
 
@@ -633,6 +639,29 @@ void _aptExit()
 	svc_closeHandle(aptLockHandle);
 }
 
+#ifdef MULTIMENU
+#define MENU_SLOTS_REGIONFREE 0
+#define MENU_SLOTS_LOADROPBIN 1
+#define MENU_SLOTS_ROPBIN 2
+
+// the menu payloads were built for several menu versions at once; menu_slots.bin
+// has the values of this one's constants and where they go (see scripts/menuSlots.py)
+void patchMenuSlots(u32* payload_dst, int payload)
+{
+	const u32* slots = (const u32*)menu_slots_bin;
+	const u32* values = &slots[2];
+	const u32* relocs = &values[slots[1]];
+
+	int i;
+	for(i=0; i<payload; i++) relocs = &relocs[1 + relocs[0] * 2];
+	for(i=0; i<relocs[0]; i++)
+	{
+		u32 info = relocs[2 + i * 2];
+		payload_dst[relocs[1 + i * 2] / 4] = values[info & 0xFFFF] + (s16)(info >> 16);
+	}
+}
+#endif
+
 void inject_payload(u32* linear_buffer, u32 target_address)
 {
 	u32 target_base = target_address & ~0xFF;
@@ -651,26 +680,39 @@ void inject_payload(u32* linear_buffer, u32 target_address)
 	{
 		u32* payload_src;
 		u32 payload_size;
+		u32* relocs;
 
 		#ifndef LOADROPBIN
 			payload_src = (u32*)menu_payload_regionfree_bin;
 			payload_size = menu_payload_regionfree_bin_size;
+			relocs = (u32*)menu_payload_regionfree_relocs_bin;
 		#else
 			payload_src = (u32*)menu_payload_loadropbin_bin;
 			payload_size = menu_payload_loadropbin_bin_size;
+			relocs = (u32*)menu_payload_loadropbin_relocs_bin;
 		#endif
 
 		u32* payload_dst = &(linear_buffer)[target_offset/4];
 
-		//patch in payload
-		int i;
-		for(i=0; i<payload_size/4; i++)
+		//patch in payload, relocs says where its 0xBABE0000 relative words (0) and 0xDEADCAFE holes (1) are
+		u32 i = 0;
+		int j;
+		for(j=0; j<relocs[0]; j++)
 		{
-			if(payload_src[i] < 0xBABE0000+0x100 && payload_src[i] > 0xBABE0000-0x100)
-			{
-				payload_dst[i] = payload_src[i] + target_address - 0xBABE0000;
-			}else if(payload_src[i] != 0xDEADCAFE) payload_dst[i] = payload_src[i];
+			u32 k = relocs[1+j] >> 16;
+			memcpy(&payload_dst[i], &payload_src[i], (k - i) * 4);
+			if((relocs[1+j] & 0xFFFF) == 0) payload_dst[k] = payload_src[k] + target_address - 0xBABE0000;
+			i = k + 1;
 		}
+		memcpy(&payload_dst[i], &payload_src[i], (payload_size/4 - i) * 4);
+
+		#ifdef MULTIMENU
+			#ifndef LOADROPBIN
+				patchMenuSlots(payload_dst, MENU_SLOTS_REGIONFREE);
+			#else
+				patchMenuSlots(payload_dst, MENU_SLOTS_LOADROPBIN);
+			#endif
+		#endif
 
 		GSP_FlushDCache(linear_buffer, 0x00001000);
 
@@ -745,7 +787,27 @@ int main(u32 loaderparam, char** argv)
 		u32 *ptr32 = (u32*)menu_ropbin_bin;
 
 		// Decompress menu_ropbin_bin into homemenu linearmem.
-		lz11Decompress(&menu_ropbin_bin[4], (u8*)linear_buffer, ptr32[0] >> 8);
+		// compress.exe --auto picks the format, the type byte says which.
+		switch(menu_ropbin_bin[0])
+		{
+			case 0x10:
+				lzssDecompress(&menu_ropbin_bin[4], (u8*)linear_buffer, ptr32[0] >> 8);
+				break;
+			case 0x24:
+			case 0x28:
+				huffDecompress(&menu_ropbin_bin[4], (u8*)linear_buffer, ptr32[0] >> 8, menu_ropbin_bin[0] & 0xF);
+				break;
+			case 0x30:
+				rleDecompress(&menu_ropbin_bin[4], (u8*)linear_buffer, ptr32[0] >> 8);
+				break;
+			default:
+				lz11Decompress(&menu_ropbin_bin[4], (u8*)linear_buffer, ptr32[0] >> 8);
+				break;
+		}
+
+		#ifdef MULTIMENU
+			patchMenuSlots(linear_buffer, MENU_SLOTS_ROPBIN);
+		#endif
 
 		// copy un-processed ropbin to backup location
 		GSP_FlushDCache(linear_buffer, binsize);
@@ -0,0 +1,6 @@
+#include "decompress.h"
+#include "../../compress/rle.h"
+
+void rleDecompress(const u8 *src, u8 *dst, int size) {
+  rle_decode(src, dst, size);
+}
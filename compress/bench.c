@@ -0,0 +1,668 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "compress.h"
+
+// Runs every codec over a corpus of synthetic data plus whatever files are
+// named on the command line, and prints one tab-separated line per input
+// and codec:
+//
+//   name codec size packed ratio enc_mbps dec_mbps peak_kib
+//
+// Each measurement runs in a child process so that peak_kib is the peak
+// resident memory the encoder and decoder added on top of the input. Every
+// input ends right before an inaccessible page, so a codec that reads past
+// the end fails instead of seeing whatever follows.
+//
+// With --baseline, results are compared against an earlier run: any input
+// that packs larger than before fails. With --tolerance, so does any
+// throughput that dropped by more than that many percent; it is off by
+// default, since it only means something on the machine that recorded the
+// baseline.
+
+typedef enum
+{
+  CODEC_LZ10,
+  CODEC_LZ11,
+  CODEC_BLZ,
+  CODEC_RLE,
+  CODEC_HUFF,
+} format_t;
+
+typedef struct
+{
+  const char     *name;
+  format_t       format;
+  lzss_parser_t  parser;
+  unsigned       lazy;
+  lzss_matcher_t matcher;
+} codec_t;
+
+static const codec_t codecs[] =
+{
+  { "lz10",       CODEC_LZ10, LZSS_PARSER_GREEDY,  1, LZSS_MATCHER_HASH, },
+  { "lz10-lazy0", CODEC_LZ10, LZSS_PARSER_GREEDY,  0, LZSS_MATCHER_HASH, },
+  { "lz10-lazy2", CODEC_LZ10, LZSS_PARSER_GREEDY,  2, LZSS_MATCHER_HASH, },
+  { "lz10-opt",   CODEC_LZ10, LZSS_PARSER_OPTIMAL, 1, LZSS_MATCHER_HASH, },
+  { "lz10-scan",  CODEC_LZ10, LZSS_PARSER_GREEDY,  2, LZSS_MATCHER_SCAN, },
+  { "lz11",       CODEC_LZ11, LZSS_PARSER_GREEDY,  1, LZSS_MATCHER_HASH, },
+  { "lz11-lazy0", CODEC_LZ11, LZSS_PARSER_GREEDY,  0, LZSS_MATCHER_HASH, },
+  { "lz11-lazy2", CODEC_LZ11, LZSS_PARSER_GREEDY,  2, LZSS_MATCHER_HASH, },
+  { "lz11-opt",   CODEC_LZ11, LZSS_PARSER_OPTIMAL, 1, LZSS_MATCHER_HASH, },
+  { "lz11-scan",  CODEC_LZ11, LZSS_PARSER_GREEDY,  2, LZSS_MATCHER_SCAN, },
+  { "blz",        CODEC_BLZ,  LZSS_PARSER_GREEDY,  1, LZSS_MATCHER_HASH, },
+  { "blz-opt",    CODEC_BLZ,  LZSS_PARSER_OPTIMAL, 1, LZSS_MATCHER_HASH, },
+  { "rle",        CODEC_RLE,  LZSS_PARSER_GREEDY,  1, LZSS_MATCHER_HASH, },
+  { "huff",       CODEC_HUFF, LZSS_PARSER_GREEDY,  1, LZSS_MATCHER_HASH, },
+};
+
+#define NUM_CODECS (sizeof(codecs) / sizeof(codecs[0]))
+
+typedef struct
+{
+  size_t size;
+  size_t packed;
+  double enc_mbps;
+  double dec_mbps;
+  long   peak_kib;
+} result_t;
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// len bytes that end where an inaccessible page starts
+static uint8_t*
+guarded_alloc(size_t len)
+{
+  size_t  page = sysconf(_SC_PAGESIZE);
+  size_t  size = (len + page - 1) / page * page;
+  uint8_t *p   = mmap(NULL, size + page, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if(p == MAP_FAILED)
+    return NULL;
+
+  if(mprotect(p + size, page, PROT_NONE) != 0)
+  {
+    munmap(p, size + page);
+    return NULL;
+  }
+
+  return p + size - len;
+}
+
+static void
+guarded_free(uint8_t *p, size_t len)
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = (len + page - 1) / page * page;
+
+  munmap(p + len - size, size + page);
+}
+
+static uint8_t*
+read_file(const char *name, size_t *len)
+{
+  FILE    *fp = fopen(name, "rb");
+  uint8_t *data;
+  long    size;
+
+  if(!fp)
+    return NULL;
+
+  if(fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0
+  || fseek(fp, 0, SEEK_SET) != 0)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  data = guarded_alloc(size);
+  if(data && fread(data, 1, size, fp) != (size_t)size)
+  {
+    guarded_free(data, size);
+    data = NULL;
+  }
+
+  fclose(fp);
+  *len = size;
+  return data;
+}
+
+/*******************************************************************************
+ * synthetic corpus
+ ******************************************************************************/
+
+static uint32_t
+rng(uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void
+gen_zeros(uint8_t *p, size_t len, uint32_t *state)
+{
+  (void)state;
+  memset(p, 0, len);
+}
+
+static void
+gen_random(uint8_t *p, size_t len, uint32_t *state)
+{
+  size_t i;
+
+  for(i = 0; i < len; ++i)
+    p[i] = rng(state);
+}
+
+// words from a small vocabulary, like strings tables and logs
+static void
+gen_text(uint8_t *p, size_t len, uint32_t *state)
+{
+  static const char *words[] =
+  {
+    "the", "payload", "rop", "gadget", "stack", "pivot", "menu", "loader",
+    "memory", "address", "kernel", "service", "handle", "buffer", "error",
+    "version", "region", "firmware", "code", "data", "0x00100000", "svc",
+  };
+  size_t i = 0;
+
+  while(i < len)
+  {
+    const char *w = words[rng(state) % (sizeof(words) / sizeof(words[0]))];
+
+    while(*w && i < len)
+      p[i++] = *w++;
+    if(i < len)
+      p[i++] = rng(state) % 11 == 0 ? '\n' : ' ';
+  }
+}
+
+// 32-bit words from a pool of instructions with varying register fields and
+// a sprinkling of literal pool constants, like ARM code
+static void
+gen_code(uint8_t *p, size_t len, uint32_t *state)
+{
+  uint32_t pool[256];
+  size_t   i;
+
+  for(i = 0; i < 256; ++i)
+    pool[i] = 0xE0000000 | (rng(state) & 0x0FF00000);
+
+  for(i = 0; i + 4 <= len; i += 4)
+  {
+    uint32_t r = rng(state), v;
+
+    if(r % 13 == 0)
+      v = 0x00100000 + (rng(state) & 0x000FFFFC);
+    else
+      v = pool[r & 0xFF] | ((r >> 8) & 0x0000F00F) | (((r >> 16) & 3) << 12);
+
+    p[i+0] = v;
+    p[i+1] = v >> 8;
+    p[i+2] = v >> 16;
+    p[i+3] = v >> 24;
+  }
+
+  for(; i < len; ++i)
+    p[i] = 0;
+}
+
+// mostly zero with random islands, like padded images and bss
+static void
+gen_sparse(uint8_t *p, size_t len, uint32_t *state)
+{
+  size_t i = 0;
+
+  memset(p, 0, len);
+  while(i < len)
+  {
+    size_t gap = rng(state) % 4096, run = rng(state) % 512;
+
+    for(i += gap; run-- > 0 && i < len; ++i)
+      p[i] = rng(state);
+  }
+}
+
+// code repeated from its start and cut off mid-repeat, so the input ends
+// inside one long match and the lazy steps look ahead up to the end
+static void
+gen_tail(uint8_t *p, size_t len, uint32_t *state)
+{
+  size_t i, half = len / 2 + 3;
+
+  gen_code(p, half, state);
+  for(i = half; i < len; ++i)
+    p[i] = p[i - half];
+}
+
+typedef struct
+{
+  const char *name;
+  size_t     len;
+  void       (*gen)(uint8_t *p, size_t len, uint32_t *state);
+} synthetic_t;
+
+static const synthetic_t synthetic[] =
+{
+  { "syn:zeros",  64 * 1024,  gen_zeros,  },
+  { "syn:random", 64 * 1024,  gen_random, },
+  { "syn:text",   256 * 1024, gen_text,   },
+  { "syn:code",   256 * 1024, gen_code,   },
+  { "syn:sparse", 256 * 1024, gen_sparse, },
+  { "syn:tail",   5 * 1000,   gen_tail,   },
+};
+
+/*******************************************************************************
+ * measurement
+ ******************************************************************************/
+
+static void*
+encode(const codec_t *codec, const uint8_t *data, size_t len, size_t *outlen)
+{
+  lzss_options_t opts;
+
+  lzss_options_init(&opts);
+  opts.parser = codec->parser;
+  opts.lazy    = codec->lazy;
+  opts.matcher = codec->matcher;
+
+  switch(codec->format)
+  {
+    case CODEC_LZ10: return lzss_encode_opts(data, len, outlen, &opts);
+    case CODEC_LZ11: return lz11_encode_opts(data, len, outlen, &opts);
+    case CODEC_BLZ:  return blz_encode_opts(data, len, outlen, &opts);
+    case CODEC_RLE:  return rle_encode(data, len, outlen);
+    default:         return huff_encode(data, len, outlen);
+  }
+}
+
+// the decoders the payloads use; out holds len bytes plus room for
+// blz_decode to copy in stored data padded to a word
+static int
+decode(const codec_t *codec, const uint8_t *packed, size_t packed_len,
+       uint8_t *out, size_t len)
+{
+  size_t header_len = codec->format == CODEC_BLZ ? 0
+                    : compression_size(packed, &len);
+
+  switch(codec->format)
+  {
+    case CODEC_LZ10:
+      lzss_decode_fast(packed + header_len, out, len);
+      return 0;
+
+    case CODEC_LZ11:
+      lz11_decode_fast(packed + header_len, out, len);
+      return 0;
+
+    case CODEC_BLZ:
+      return blz_decode(packed, packed_len, out, len + 8);
+
+    case CODEC_RLE:
+      rle_decode(packed + header_len, out, len);
+      return 0;
+
+    default:
+      huff_decode(packed + header_len, out, len, packed[0] & 0x0F);
+      return 0;
+  }
+}
+
+// runs per second since start
+static double
+rate(double start, unsigned runs)
+{
+  double elapsed = now() - start;
+
+  return elapsed > 0 ? runs / elapsed : 0;
+}
+
+// each timing loop repeats for at least this many seconds
+#define MIN_TIME 0.2
+
+static int
+measure(const codec_t *codec, const uint8_t *data, size_t len,
+        result_t *result)
+{
+  struct rusage usage;
+  uint8_t       *packed = NULL, *out;
+  size_t        packed_len;
+  long          base;
+  unsigned      runs;
+  double        start;
+
+  getrusage(RUSAGE_SELF, &usage);
+  base = usage.ru_maxrss;
+
+  out = malloc(len + 8);
+  if(!out)
+    return -1;
+
+  start = now();
+  runs  = 0;
+  do
+  {
+    free(packed);
+    packed = encode(codec, data, len, &packed_len);
+    if(!packed)
+    {
+      free(out);
+      return -1;
+    }
+    ++runs;
+  } while(now() - start < MIN_TIME);
+  result->enc_mbps = len * rate(start, runs) / 1e6;
+
+  start = now();
+  runs  = 0;
+  do
+  {
+    if(decode(codec, packed, packed_len, out, len) != 0)
+      break;
+    ++runs;
+  } while(now() - start < MIN_TIME);
+  result->dec_mbps = len * rate(start, runs) / 1e6;
+
+  if(runs == 0 || memcmp(out, data, len) != 0)
+  {
+    free(packed);
+    free(out);
+    return -1;
+  }
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  result->size     = len;
+  result->packed   = packed_len;
+  result->peak_kib = usage.ru_maxrss - base;
+
+  free(packed);
+  free(out);
+  return 0;
+}
+
+// run measure() in a child so each peak is measured on its own
+static int
+measure_isolated(const codec_t *codec, const uint8_t *data, size_t len,
+                 result_t *result)
+{
+  int   fds[2], status, ok;
+  pid_t pid;
+
+  if(pipe(fds) != 0)
+    return -1;
+
+  fflush(stdout);
+  pid = fork();
+  if(pid < 0)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+
+  if(pid == 0)
+  {
+    close(fds[0]);
+    if(measure(codec, data, len, result) != 0
+    || write(fds[1], result, sizeof(*result)) != sizeof(*result))
+      _exit(EXIT_FAILURE);
+    _exit(EXIT_SUCCESS);
+  }
+
+  close(fds[1]);
+  ok = read(fds[0], result, sizeof(*result)) == sizeof(*result);
+  close(fds[0]);
+
+  if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+  || WEXITSTATUS(status) != EXIT_SUCCESS || !ok)
+    return -1;
+
+  return 0;
+}
+
+/*******************************************************************************
+ * baseline
+ ******************************************************************************/
+
+typedef struct
+{
+  char     name[256];
+  char     codec[32];
+  result_t result;
+} baseline_t;
+
+static baseline_t *baseline;
+static size_t     baseline_len;
+
+static int
+load_baseline(const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  char line[512];
+
+  if(!fp)
+    return -1;
+
+  while(fgets(line, sizeof(line), fp))
+  {
+    baseline_t entry;
+    double     ratio;
+    void       *tmp;
+
+    if(sscanf(line, "%255s %31s %zu %zu %lf %lf %lf %ld", entry.name,
+              entry.codec, &entry.result.size, &entry.result.packed, &ratio,
+              &entry.result.enc_mbps, &entry.result.dec_mbps,
+              &entry.result.peak_kib) != 8)
+      continue; // header or junk
+
+    tmp = realloc(baseline, (baseline_len + 1) * sizeof(*baseline));
+    if(!tmp)
+    {
+      fclose(fp);
+      return -1;
+    }
+
+    baseline = tmp;
+    baseline[baseline_len++] = entry;
+  }
+
+  fclose(fp);
+  return 0;
+}
+
+static const result_t*
+find_baseline(const char *name, const char *codec)
+{
+  size_t i;
+
+  for(i = 0; i < baseline_len; ++i)
+  {
+    if(strcmp(baseline[i].name, name) == 0
+    && strcmp(baseline[i].codec, codec) == 0)
+      return &baseline[i].result;
+  }
+
+  return NULL;
+}
+
+// report how result compares to the baseline; returns the number of
+// regressions
+static int
+check(const char *name, const char *codec, const result_t *result,
+      double tolerance)
+{
+  const result_t *base = find_baseline(name, codec);
+  int            regressions = 0;
+
+  if(!base || base->size != result->size)
+    return 0;
+
+  if(result->packed > base->packed)
+  {
+    fprintf(stderr, "%s %s: packed %zu -> %zu bytes\n", name, codec,
+            base->packed, result->packed);
+    ++regressions;
+  }
+
+  if(tolerance > 0)
+  {
+    double floor = 1 - tolerance / 100;
+
+    if(result->enc_mbps < base->enc_mbps * floor)
+    {
+      fprintf(stderr, "%s %s: encode %.1f -> %.1f MB/s\n", name, codec,
+              base->enc_mbps, result->enc_mbps);
+      ++regressions;
+    }
+
+    if(result->dec_mbps < base->dec_mbps * floor)
+    {
+      fprintf(stderr, "%s %s: decode %.1f -> %.1f MB/s\n", name, codec,
+              base->dec_mbps, result->dec_mbps);
+      ++regressions;
+    }
+  }
+
+  return regressions;
+}
+
+/*******************************************************************************
+ * main
+ ******************************************************************************/
+
+static int
+run(const char *name, const uint8_t *data, size_t len, double tolerance,
+    int *regressions)
+{
+  size_t i;
+  int    rc = 0;
+
+  for(i = 0; i < NUM_CODECS; ++i)
+  {
+    result_t result;
+
+    if(measure_isolated(&codecs[i], data, len, &result) != 0)
+    {
+      fprintf(stderr, "%s %s: failed\n", name, codecs[i].name);
+      rc = -1;
+      continue;
+    }
+
+    printf("%s\t%s\t%zu\t%zu\t%.4f\t%.2f\t%.2f\t%ld\n", name, codecs[i].name,
+           result.size, result.packed,
+           result.size ? (double)result.packed / result.size : 0,
+           result.enc_mbps, result.dec_mbps, result.peak_kib);
+
+    *regressions += check(name, codecs[i].name, &result, tolerance);
+  }
+
+  return rc;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [--baseline file] [--tolerance percent] "
+                  "[--no-synthetic] [file...]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *baseline_path = NULL;
+  double     tolerance = 0;
+  int        synthetic_on = 1, regressions = 0, rc = EXIT_SUCCESS, argi;
+  size_t     i;
+
+  for(argi = 1; argi < argc && strncmp(argv[argi], "--", 2) == 0; ++argi)
+  {
+    if(strcmp(argv[argi], "--") == 0)
+    {
+      ++argi;
+      break;
+    }
+    else if(strcmp(argv[argi], "--baseline") == 0 && argi + 1 < argc)
+      baseline_path = argv[++argi];
+    else if(strcmp(argv[argi], "--tolerance") == 0 && argi + 1 < argc)
+      tolerance = atof(argv[++argi]);
+    else if(strcmp(argv[argi], "--no-synthetic") == 0)
+      synthetic_on = 0;
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(baseline_path && load_baseline(baseline_path) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", baseline_path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  printf("name\tcodec\tsize\tpacked\tratio\tenc_mbps\tdec_mbps\tpeak_kib\n");
+
+  for(i = 0; synthetic_on && i < sizeof(synthetic) / sizeof(synthetic[0]); ++i)
+  {
+    uint32_t state = 0x3D5u + i;
+    uint8_t  *data = guarded_alloc(synthetic[i].len);
+
+    if(!data)
+    {
+      fprintf(stderr, "%s: %s\n", synthetic[i].name, strerror(ENOMEM));
+      return EXIT_FAILURE;
+    }
+
+    synthetic[i].gen(data, synthetic[i].len, &state);
+    if(run(synthetic[i].name, data, synthetic[i].len, tolerance,
+           &regressions) != 0)
+      rc = EXIT_FAILURE;
+    guarded_free(data, synthetic[i].len);
+  }
+
+  for(; argi < argc; ++argi)
+  {
+    uint8_t *data;
+    size_t  len;
+
+    data = read_file(argv[argi], &len);
+    if(!data)
+    {
+      fprintf(stderr, "%s: %s\n", argv[argi], strerror(errno));
+      rc = EXIT_FAILURE;
+      continue;
+    }
+
+    if(run(argv[argi], data, len, tolerance, &regressions) != 0)
+      rc = EXIT_FAILURE;
+    guarded_free(data, len);
+  }
+
+  if(regressions)
+  {
+    fprintf(stderr, "%d regression%s against %s\n", regressions,
+            regressions == 1 ? "" : "s", baseline_path);
+    rc = EXIT_FAILURE;
+  }
+
+  free(baseline);
+  return rc;
+}
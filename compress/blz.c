@@ -0,0 +1,172 @@
+#define COMPRESSION_INTERNAL
+#include "compress.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bottom-up LZ, as used for ExeFS .code and our secondary payloads.
+//
+// File layout:
+// - uncompressed prefix
+// - compressed tokens, to be read from the end backwards
+// - 0xFF padding to a multiple of 4
+// - footer: u32 (header length << 24) | (compressed length + header length)
+//           u32 decompressed size - file size
+//
+// Input that does not compress is stored as is, padded with zeroes to a
+// multiple of 4 and followed by a zero u32.
+//
+// The decoder writes from the end of the output buffer towards its start
+// while reading the tokens the same way, so it can run in place as long as
+// the write pointer never overtakes the read pointer. The prefix is the
+// part of the input that is cheaper, or only safe, to leave uncompressed.
+
+static void
+reverse(uint8_t *dst, const uint8_t *src, size_t len)
+{
+  size_t i;
+
+  for(i = 0; i < len; ++i)
+    dst[i] = src[len - i - 1];
+}
+
+static inline void
+put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+// Walk the token stream and find the cut that minimises the packed size of
+// the tokens before it plus the raw size of the input after it. At that
+// cut the write pointer can never pass the read pointer: after any earlier
+// token t, packed_t + raw_t >= packed_cut + raw_cut.
+static void
+blz_find_cut(const uint8_t *stream,
+             size_t        len,
+             size_t        *packed,
+             size_t        *consumed)
+{
+  const uint8_t *p = stream;
+  size_t        done = 0, best = len;
+  int           i;
+  uint8_t       flags;
+
+  *packed   = 0;
+  *consumed = 0;
+
+  while(done < len)
+  {
+    flags = *p++;
+    for(i = 0; i < 8 && done < len; i++, flags <<= 1)
+    {
+      if(flags & 0x80)
+      {
+        done += ((*p)>>4) + 3;
+        p    += 2;
+      }
+      else
+      {
+        done += 1;
+        p    += 1;
+      }
+
+      if((size_t)(p - stream) + len - done < best)
+      {
+        best      = (p - stream) + len - done;
+        *packed   = p - stream;
+        *consumed = done;
+      }
+    }
+  }
+}
+
+// not worth it; store the input padded, like blz.exe does
+static void*
+blz_store(const uint8_t *input, size_t len, size_t *outlen)
+{
+  size_t  size   = ((len + 3) & ~3) + 4;
+  uint8_t *result = malloc(size);
+
+  if(!result)
+    return NULL;
+
+  memcpy(result, input, len);
+  memset(result + len, 0, size - len);
+  *outlen = size;
+  return result;
+}
+
+void*
+blz_encode_opts(const void           *src,
+                size_t               len,
+                size_t               *outlen,
+                const lzss_options_t *opts)
+{
+  const uint8_t *input = (const uint8_t*)src;
+  uint8_t       *reversed, *stream, *result;
+  size_t        stream_len, packed, consumed, raw, size, header, stored;
+
+  if(len >= BLZ_MAX_INPUT)
+    return NULL;
+
+  // nothing to compress, and no buffer to reverse it into
+  if(len == 0)
+    return blz_store(input, len, outlen);
+
+  reversed = malloc(len);
+  if(!reversed)
+    return NULL;
+
+  reverse(reversed, input, len);
+  stream = lzss_range_encode(reversed, reversed, len, &stream_len, BLZ, opts,
+                             NULL);
+  free(reversed);
+  if(!stream)
+    return NULL;
+
+  blz_find_cut(stream, len, &packed, &consumed);
+  raw = len - consumed;
+
+  header = 8 + (-(raw + packed) & 3);
+  size   = raw + packed + header;
+  stored = ((len + 3) & ~3) + 4;
+
+  // a zero size increase marks stored data, so size must differ from len
+  if(packed == 0 || size >= stored || size == len)
+  {
+    free(stream);
+    return blz_store(input, len, outlen);
+  }
+
+  result = malloc(size);
+  if(!result)
+  {
+    free(stream);
+    return NULL;
+  }
+
+  memcpy(result, input, raw);
+  reverse(result + raw, stream, packed);
+  memset(result + raw + packed, 0xFF, header - 8);
+  put32(result + size - 8, (header << 24) | (packed + header));
+  put32(result + size - 4, len - size);
+
+  free(stream);
+  *outlen = size;
+  return result;
+}
+
+void*
+blz_encode(const void *src,
+           size_t     len,
+           size_t     *outlen)
+{
+  lzss_options_t opts;
+
+  lzss_options_init(&opts);
+  return blz_encode_opts(src, len, outlen, &opts);
+}
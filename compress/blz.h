@@ -0,0 +1,140 @@
+#pragma once
+
+// Bottom-up LZ decoder. Header-only and free of libc calls so that the
+// payloads can include it directly; see blz.c for the format.
+
+#include <stdint.h>
+
+static inline uint32_t
+blz_get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+       | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t
+blz_decoded_size(const uint8_t *src, uint32_t len)
+{
+  if(len < 4)
+    return 0;
+
+  return len + blz_get32(src + len - 4);
+}
+
+// Copy count bytes to p from disp bytes above it, highest first, as the
+// format defines. With disp >= 8 the bytes move eight at a time, which can
+// clobber up to 7 bytes below p; wide says the caller allows that.
+static inline void
+blz_copy(uint8_t *p, uint32_t count, uint32_t disp, int wide)
+{
+  int32_t j = count;
+
+  if(wide && disp >= 8)
+  {
+    do
+    {
+      j -= 8;
+      __builtin_memcpy(p + j, p + j + disp, 8);
+    } while(j > 0);
+  }
+  else
+  {
+    while(j-- > 0)
+      p[j] = p[j + disp];
+  }
+}
+
+// Decode the len bytes at src into dst, which must hold blz_decoded_size()
+// bytes (and at least len). src may equal dst to decode in place. Returns 0
+// on success and -1 on malformed input, without touching memory outside
+// either buffer.
+static inline int
+blz_decode(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t size)
+{
+  uint32_t top, end, out, index, stop, i;
+  uint8_t  flags;
+
+  if(len < 4 || len > size)
+    return -1;
+
+  // the prefix is stored as is
+  if(dst != src)
+  {
+    for(i = 0; i < len; ++i)
+      dst[i] = src[i];
+  }
+
+  // stored rather than compressed
+  if(blz_get32(src + len - 4) == 0)
+    return 0;
+
+  if(len < 8)
+    return -1;
+
+  top   = blz_get32(src + len - 8);
+  end   = blz_decoded_size(src, len);
+  out   = end;
+  index = top >> 24;
+  stop  = top & 0xFFFFFF;
+
+  if(out > size || index > len || stop > len || index > stop)
+    return -1;
+
+  index = len - index;
+  stop  = len - stop;
+
+  while(index > stop)
+  {
+    // everything below out that is still needed: the prefix, and when
+    // decoding in place the tokens not read yet
+    uint32_t low = dst == src ? index : stop;
+
+    flags = src[--index];
+
+    // eight literals
+    if(flags == 0 && index - stop >= 8 && out >= 8)
+    {
+      if(dst == src && out < index)
+        return -1;
+
+      for(i = 0; i < 8; ++i)
+        dst[--out] = src[--index];
+      continue;
+    }
+
+    for(i = 0; i < 8 && index > stop; i++, flags <<= 1)
+    {
+      if(flags & 0x80)
+      {
+        uint32_t token, count, disp;
+
+        if(index < 2)
+          return -1;
+
+        index -= 2;
+        token  = src[index] | (src[index+1] << 8);
+        count  = (token >> 12) + 3;
+        disp   = (token & 0x0FFF) + 3;
+
+        if(out < count || out - 1 + disp >= end)
+          return -1;
+
+        // writing in place must not overtake the tokens still to be read
+        if(dst == src && out - count < index)
+          return -1;
+
+        out -= count;
+        blz_copy(dst + out, count, disp, out >= low + 7);
+      }
+      else
+      {
+        if(out < 1 || (dst == src && out < index))
+          return -1;
+
+        dst[--out] = src[--index];
+      }
+    }
+  }
+
+  return 0;
+}
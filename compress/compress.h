@@ -10,25 +10,118 @@ extern "C"
 #include <stdint.h>
 #endif
 
+typedef enum
+{
+  LZSS_MATCHER_HASH, // hash chains over 3-byte prefixes
+  LZSS_MATCHER_SCAN, // backwards memrchr scan of the whole window
+} lzss_matcher_t;
+
+typedef enum
+{
+  LZSS_PARSER_GREEDY,  // greedy with lazy steps of lookahead
+  LZSS_PARSER_OPTIMAL, // minimum-size parse by dynamic programming
+} lzss_parser_t;
+
+typedef struct
+{
+  lzss_matcher_t matcher;
+  lzss_parser_t  parser;
+
+  // tokens the greedy parser looks ahead before taking a match: 0 takes
+  // the longest match as is, 1 weighs it against a literal followed by a
+  // match, 2 follows both choices for one more token
+  unsigned       lazy;
+
+  // inputs larger than block_size are split into blocks compressed by this
+  // many threads; with prime set, each block may still reference the
+  // window that precedes it, otherwise the window restarts at every block
+  unsigned       threads;
+  size_t         block_size;
+  int            prime;
+} lzss_options_t;
+
+void lzss_options_init(lzss_options_t *opts);
+
+// where the *_encode_to functions hand their output, piece by piece;
+// write returns 0 on success
+typedef struct
+{
+  int  (*write)(void *ctx, const void *data, size_t len);
+  void *ctx;
+} lzss_sink_t;
+
 void* lzss_encode(const void *src, size_t len, size_t *outlen);
+void* lzss_encode_opts(const void *src, size_t len, size_t *outlen,
+                       const lzss_options_t *opts);
+// like lzss_encode_opts, but the output goes to sink as flag groups
+// complete; returns the number of bytes written, or 0 on failure
+size_t lzss_encode_to(const void *src, size_t len, const lzss_sink_t *sink,
+                      const lzss_options_t *opts);
+// see lzss_fast.h for word-wide variants of both decoders
 void  lzss_decode(const void *src, void *dst, size_t len);
 
 void* lz11_encode(const void *src, size_t len, size_t *outlen);
+void* lz11_encode_opts(const void *src, size_t len, size_t *outlen,
+                       const lzss_options_t *opts);
+size_t lz11_encode_to(const void *src, size_t len, const lzss_sink_t *sink,
+                      const lzss_options_t *opts);
+// see lz11_stream.h for a decoder that takes its input in pieces
 void  lz11_decode(const void *src, void *dst, size_t len);
 
+// bottom-up LZ, decoded backwards and in place; see blz.h for the decoder.
+// The footer has 24 bits for the compressed length, so inputs of
+// BLZ_MAX_INPUT bytes or more give NULL.
+#define BLZ_MAX_INPUT 0x1000000
+void* blz_encode(const void *src, size_t len, size_t *outlen);
+void* blz_encode_opts(const void *src, size_t len, size_t *outlen,
+                      const lzss_options_t *opts);
+
+// type 0x30; see rle.h for the decoder
 void* rle_encode(const void *src, size_t len, size_t *outlen);
-void  rle_decode(const void *src, void *dst, size_t len);
 
+// type 0x24 or 0x28, whichever symbol size packs smaller; see huff.h for
+// the decoder
 void* huff_encode(const void *src, size_t len, size_t *outlen);
-void  huff_decode(const void *src, void *dst, size_t len);
 
-static inline void
-compression_header(uint8_t header[4], uint8_t type, size_t size)
+#include "blz.h"
+#include "lz11_stream.h"
+#include "lzss_fast.h"
+#include "rle.h"
+#include "huff.h"
+
+// Sizes that do not fit in 24 bits, and zero, are written as 0 followed by
+// a 32-bit size. Returns the header length, 4 or 8.
+static inline size_t
+compression_header(uint8_t header[8], uint8_t type, size_t size)
 {
   header[0] = type;
-  header[1] = size;
-  header[2] = size >> 8;
-  header[3] = size >> 16;
+  if(size > 0 && size <= 0xFFFFFF)
+  {
+    header[1] = size;
+    header[2] = size >> 8;
+    header[3] = size >> 16;
+    return 4;
+  }
+
+  header[1] = header[2] = header[3] = 0;
+  header[4] = size;
+  header[5] = size >> 8;
+  header[6] = size >> 16;
+  header[7] = size >> 24;
+  return 8;
+}
+
+// read the size from a header; returns the header length
+static inline size_t
+compression_size(const uint8_t *header, size_t *size)
+{
+  *size = header[1] | (header[2] << 8) | (header[3] << 16);
+  if(*size != 0)
+    return 4;
+
+  *size = header[4] | (header[5] << 8) | (header[6] << 16)
+        | ((size_t)header[7] << 24);
+  return 8;
 }
 
 #ifdef COMPRESSION_INTERNAL
@@ -55,7 +148,11 @@ buffer_push(buffer_t *buffer, const uint8_t *data, size_t len)
 {
   if(len + buffer->len > buffer->limit)
   {
-    size_t limit = (len + buffer->len + 0x0FFF) & ~0x0FFF;
+    // grow geometrically, so that pushing n bytes costs O(n) copying
+    size_t limit = len + buffer->len > 2 * buffer->limit
+                 ? len + buffer->len : 2 * buffer->limit;
+
+    limit = (limit + 0x0FFF) & ~0x0FFF;
     uint8_t *tmp = realloc(buffer->data, limit);
     if(tmp)
     {
@@ -92,6 +189,101 @@ buffer_destroy(buffer_t *buffer)
 {
   free(buffer->data);
 }
+
+#define LZ10_MAX_LEN  18
+#define LZ10_MAX_DISP 4096
+
+#define LZ11_MAX_LEN  65808
+#define LZ11_MAX_DISP 4096
+
+#define BLZ_MAX_LEN  18
+#define BLZ_MIN_DISP 3
+#define BLZ_MAX_DISP 0x1002
+
+typedef enum
+{
+  LZ10,
+  LZ11,
+  BLZ, // LZ10 tokens over the reversed input, without a header
+} lzss_mode_t;
+
+static inline size_t
+lzss_max_len(lzss_mode_t mode)
+{
+  return mode == LZ11 ? LZ11_MAX_LEN : mode == BLZ ? BLZ_MAX_LEN : LZ10_MAX_LEN;
+}
+
+static inline size_t
+lzss_min_disp(lzss_mode_t mode)
+{
+  return mode == BLZ ? BLZ_MIN_DISP : 1;
+}
+
+static inline size_t
+lzss_max_disp(lzss_mode_t mode)
+{
+  return mode == LZ11 ? LZ11_MAX_DISP : mode == BLZ ? BLZ_MAX_DISP : LZ10_MAX_DISP;
+}
+
+typedef struct
+{
+  buffer_t    result;
+  lzss_mode_t mode;
+  size_t      code_pos; // offset of the current flag byte
+  size_t      shift;    // flag bit of the next token
+
+  // with a sink, completed flag groups are handed over and dropped from
+  // result once enough of them pile up
+  const lzss_sink_t *sink;
+  size_t            flushed; // bytes handed over so far
+} lzss_writer_t;
+
+int lzss_writer_init(lzss_writer_t *writer, lzss_mode_t mode, size_t len,
+                     const lzss_sink_t *sink);
+int lzss_writer_literal(lzss_writer_t *writer, uint8_t byte);
+int lzss_writer_match(lzss_writer_t *writer, size_t len, size_t disp);
+// with a sink, the result holds nothing but must still be freed, and
+// *outlen counts everything handed over
+void* lzss_writer_finish(lzss_writer_t *writer, size_t *outlen);
+void lzss_writer_destroy(lzss_writer_t *writer);
+
+const uint8_t* find_best_match(const uint8_t *start, const uint8_t *buffer,
+                               size_t len, size_t max_disp, size_t *outlen);
+
+// encode [buffer, buffer+len); matches may reach back as far as start; sink
+// may be NULL
+void* lzss_range_encode(const uint8_t *start, const uint8_t *buffer,
+                        size_t len, size_t *outlen, lzss_mode_t mode,
+                        const lzss_options_t *opts, const lzss_sink_t *sink);
+void* lzss_optimal_encode(const uint8_t *start, const uint8_t *buffer,
+                          size_t len, size_t *outlen, lzss_mode_t mode,
+                          const lzss_options_t *opts,
+                          const lzss_sink_t *sink);
+void* lzss_parallel_encode(const uint8_t *buffer, size_t len, size_t *outlen,
+                           lzss_mode_t mode, const lzss_options_t *opts,
+                           const lzss_sink_t *sink);
+
+#define HASH_CHAIN_HASH_BITS 16
+
+typedef struct
+{
+  const uint8_t *start;
+  const uint8_t *end;
+  size_t        min_disp;
+  size_t        max_disp;
+  uint32_t      inserted; // positions [0, inserted) are indexed
+  uint32_t      *head;    // newest position for each hash
+  uint32_t      *prev;    // ring of previous positions with the same hash
+} hash_chain_t;
+
+int hash_chain_init(hash_chain_t *hc, const uint8_t *start, size_t len,
+                    size_t min_disp, size_t max_disp);
+void hash_chain_destroy(hash_chain_t *hc);
+const uint8_t* hash_chain_find(hash_chain_t *hc, const uint8_t *buffer,
+                               size_t len, size_t *outlen);
+const uint8_t* hash_chain_longest(hash_chain_t *hc, const uint8_t *buffer,
+                                  size_t len, const uint8_t *hint,
+                                  size_t hint_len, size_t *outlen);
 #endif
 
 #ifdef __cplusplus
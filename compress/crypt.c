@@ -0,0 +1,436 @@
+#define COMPRESSION_INTERNAL
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress.h"
+
+// Packages payloads the way the loaders expect them; this used to be
+// scripts/crypt.py and scripts/blowfish.py.
+//
+// --qr: the input is LZ10-compressed with the parse of nlzss
+// (https://github.com/magical/nlzss) and zero-padded so that the whole
+// comes to a multiple of 8, then prefixed with 7 bytes:
+// - 0x80 | padding
+// - 2 unused bytes
+// - CRC-32 (MSB first, init and final xor ~0) of the unpadded LZ10 data
+// The result is Blowfish-encrypted in ECB mode, and finally its first byte
+// takes the second's place, the second the last's, and the last the first's.
+//
+// --plain: the input is padded with 1 to 8 zero bytes to a multiple of 8
+// and Blowfish-encrypted.
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options] --key=FILE input output [input output ...]\n"
+          "  --qr        compress, checksum and encrypt for the QR loaders\n"
+          "              (default)\n"
+          "  --plain     pad to 8 bytes and encrypt\n"
+          "  --key=FILE  Blowfish P-array and S-boxes\n"
+          "              (scripts/blowfish_processed.bin)\n",
+          prog);
+}
+
+static uint32_t
+get32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void
+put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static int
+read_file(const char *name, uint8_t **data, size_t *len)
+{
+  FILE   *file = fopen(name, "rb");
+  size_t limit = 0, rc;
+
+  *data = NULL;
+  *len  = 0;
+
+  if(!file)
+    return -1;
+
+  do
+  {
+    if(*len == limit)
+    {
+      uint8_t *grown;
+
+      limit = limit ? limit * 2 : 0x10000;
+      grown = realloc(*data, limit);
+      if(!grown)
+      {
+        errno = ENOMEM;
+        break;
+      }
+      *data = grown;
+    }
+
+    rc    = fread(*data + *len, 1, limit - *len, file);
+    *len += rc;
+  } while(rc > 0);
+
+  if(ferror(file) || !feof(file))
+  {
+    int err = errno;
+
+    fclose(file);
+    free(*data);
+    errno = err;
+    return -1;
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static int
+write_file(const char *name, const uint8_t *data, size_t len)
+{
+  FILE *file = fopen(name, "wb");
+
+  if(!file)
+    return -1;
+
+  if(fwrite(data, 1, len, file) != len)
+  {
+    int err = errno;
+
+    fclose(file);
+    errno = err;
+    return -1;
+  }
+
+  return fclose(file);
+}
+
+typedef struct
+{
+  uint32_t p[18];
+  uint32_t s[4][256];
+} blowfish_t;
+
+static int
+blowfish_load(blowfish_t *bf, const char *name)
+{
+  uint8_t *data;
+  size_t  len, i;
+
+  if(read_file(name, &data, &len) != 0)
+    return -1;
+
+  if(len < sizeof(*bf))
+  {
+    free(data);
+    errno = EINVAL;
+    return -1;
+  }
+
+  for(i = 0; i < 18; ++i)
+    bf->p[i] = get32(data + i * 4);
+  for(i = 0; i < 4 * 256; ++i)
+    bf->s[i / 256][i % 256] = get32(data + 18 * 4 + i * 4);
+
+  free(data);
+  return 0;
+}
+
+static inline uint32_t
+blowfish_f(const blowfish_t *bf, uint32_t x)
+{
+  return ((bf->s[0][x >> 24] + bf->s[1][(x >> 16) & 0xFF])
+         ^ bf->s[2][(x >> 8) & 0xFF]) + bf->s[3][x & 0xFF];
+}
+
+// ECB, each half of a block a little-endian word; len is a multiple of 8
+static void
+blowfish_encrypt(const blowfish_t *bf, uint8_t *data, size_t len)
+{
+  for(; len > 0; data += 8, len -= 8)
+  {
+    uint32_t l = get32(data), r = get32(data + 4), t;
+    int      i;
+
+    for(i = 0; i < 16; ++i)
+    {
+      l ^= bf->p[i];
+      r ^= blowfish_f(bf, l);
+      t  = l;
+      l  = r;
+      r  = t;
+    }
+
+    put32(data,     r ^ bf->p[17]);
+    put32(data + 4, l ^ bf->p[16]);
+  }
+}
+
+#define CRC32_POLY 0x04C11DB7
+
+static uint32_t crc_table[256];
+
+static void
+crc_init(void)
+{
+  uint32_t i, j, c;
+
+  for(i = 0; i < 256; ++i)
+  {
+    c = i << 24;
+    for(j = 0; j < 8; ++j)
+      c = c & 0x80000000 ? (c << 1) ^ CRC32_POLY : c << 1;
+    crc_table[i] = c;
+  }
+}
+
+static uint32_t
+crc32_msb(const uint8_t *data, size_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+
+  while(len-- > 0)
+    crc = (crc << 8) ^ crc_table[(crc >> 24) ^ *data++];
+
+  return ~crc;
+}
+
+#define NLZ_WINDOW    4096
+#define NLZ_MIN_DISP  2
+#define NLZ_HASH_BITS 12
+#define NLZ_NONE      ((size_t)-1)
+
+static inline size_t
+nlz_hash(const uint8_t *p)
+{
+  return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & ((1 << NLZ_HASH_BITS) - 1);
+}
+
+// LZ10 with the parse of nlzss: at every position the longest match, and
+// of those the farthest, at a distance of at least 2. Returns the header
+// and tokens without any padding.
+static uint8_t*
+nlz10_encode(const uint8_t *src, size_t len, size_t *outlen)
+{
+  size_t        head[1 << NLZ_HASH_BITS], *prev, pos = 0, added = 0;
+  lzss_writer_t writer;
+
+  // nlzss writes the size as a 24-bit header and nothing past it when empty
+  if(len == 0 || len > 0xFFFFFF)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  prev = malloc(len * sizeof(*prev));
+  if(!prev)
+    return NULL;
+
+  if(lzss_writer_init(&writer, LZ10, len, NULL) != 0)
+  {
+    free(prev);
+    return NULL;
+  }
+
+  memset(head, 0xFF, sizeof(head));
+
+  while(pos < len)
+  {
+    size_t best_len = 0, best_disp = 0, cand, max_len = len - pos;
+    int    rc;
+
+    if(max_len > LZ10_MAX_LEN)
+      max_len = LZ10_MAX_LEN;
+
+    // every position before this one is a candidate
+    for(; added < pos && added + 3 <= len; ++added)
+    {
+      size_t h = nlz_hash(src + added);
+
+      prev[added] = head[h];
+      head[h]     = added;
+    }
+
+    if(max_len >= 3)
+    {
+      // newest first, so >= keeps the farthest of the longest
+      for(cand = head[nlz_hash(src + pos)];
+          cand != NLZ_NONE && pos - cand <= NLZ_WINDOW;
+          cand = prev[cand])
+      {
+        size_t n = 0;
+
+        if(pos - cand < NLZ_MIN_DISP)
+          continue;
+
+        while(n < max_len && src[cand + n] == src[pos + n])
+          ++n;
+
+        if(n >= 3 && n >= best_len)
+        {
+          best_len  = n;
+          best_disp = pos - cand;
+        }
+      }
+    }
+
+    if(best_len)
+    {
+      rc   = lzss_writer_match(&writer, best_len, best_disp);
+      pos += best_len;
+    }
+    else
+      rc = lzss_writer_literal(&writer, src[pos++]);
+
+    if(rc != 0)
+    {
+      lzss_writer_destroy(&writer);
+      free(prev);
+      return NULL;
+    }
+  }
+
+  free(prev);
+
+  // the writer opens the next flag group as soon as one fills up; nlzss
+  // only when it has a token for it
+  if(writer.shift == 7)
+    --writer.result.len;
+
+  *outlen = writer.result.len;
+  return writer.result.data;
+}
+
+static uint8_t*
+pack_qr(const blowfish_t *bf, const uint8_t *src, size_t len, size_t *outlen)
+{
+  uint8_t *packed, *out, first;
+  size_t  packed_len, padding;
+
+  packed = nlz10_encode(src, len, &packed_len);
+  if(!packed)
+    return NULL;
+
+  padding = -(packed_len + 7) & 7;
+  *outlen = 7 + packed_len + padding;
+
+  out = calloc(*outlen, 1);
+  if(!out)
+  {
+    free(packed);
+    return NULL;
+  }
+
+  out[0] = 0x80 | padding;
+  put32(out + 3, crc32_msb(packed, packed_len));
+  memcpy(out + 7, packed, packed_len);
+  free(packed);
+
+  blowfish_encrypt(bf, out, *outlen);
+
+  first              = out[0];
+  out[0]             = out[1];
+  out[1]             = out[*outlen - 1];
+  out[*outlen - 1]   = first;
+  return out;
+}
+
+static uint8_t*
+pack_plain(const blowfish_t *bf, const uint8_t *src, size_t len,
+           size_t *outlen)
+{
+  uint8_t *out;
+
+  *outlen = len + 8 - len % 8;
+
+  out = calloc(*outlen, 1);
+  if(!out)
+    return NULL;
+
+  memcpy(out, src, len);
+  blowfish_encrypt(bf, out, *outlen);
+  return out;
+}
+
+int main(int argc, char *argv[])
+{
+  blowfish_t bf;
+  const char *key = NULL;
+  int        argi = 1, qr = 1;
+
+  for(; argi < argc && strncmp(argv[argi], "--", 2) == 0; ++argi)
+  {
+    if(strcmp(argv[argi], "--qr") == 0)
+      qr = 1;
+    else if(strcmp(argv[argi], "--plain") == 0)
+      qr = 0;
+    else if(strncmp(argv[argi], "--key=", 6) == 0 && argv[argi][6])
+      key = argv[argi] + 6;
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(!key || argi == argc || (argc - argi) % 2 != 0)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(blowfish_load(&bf, key) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", key, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  crc_init();
+
+  for(; argi < argc; argi += 2)
+  {
+    const char *in_name = argv[argi], *out_name = argv[argi + 1];
+    uint8_t    *data, *out;
+    size_t     len, outlen;
+
+    if(read_file(in_name, &data, &len) != 0)
+    {
+      fprintf(stderr, "%s: %s\n", in_name, strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+    errno = ENOMEM;
+    if(qr)
+      out = pack_qr(&bf, data, len, &outlen);
+    else
+      out = pack_plain(&bf, data, len, &outlen);
+    free(data);
+
+    if(!out)
+    {
+      fprintf(stderr, "Failed to pack %s: %s\n", in_name, strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+    if(write_file(out_name, out, outlen) != 0)
+    {
+      fprintf(stderr, "%s: %s\n", out_name, strerror(errno));
+      free(out);
+      return EXIT_FAILURE;
+    }
+
+    free(out);
+  }
+
+  return EXIT_SUCCESS;
+}
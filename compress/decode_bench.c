@@ -0,0 +1,275 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "compress.h"
+
+// Times the word-wide LZ10/LZ11 decoders against the byte loops in lzss.c,
+// and blz_decode against the ctrtool-derived lzss_decompress the payloads
+// used before, on files compressed here first.
+
+typedef uint8_t  u8;
+typedef uint32_t u32;
+
+static u32
+getle32(const u8* p)
+{
+  return (p[0]<<0) | (p[1]<<8) | (p[2]<<16) | (p[3]<<24);
+}
+
+// reference BLZ decoder, as previously copied into the payloads
+static int
+lzss_decompress(u8* compressed, u32 compressedsize, u8* decompressed, u32 decompressedsize)
+{
+  u8* footer = compressed + compressedsize - 8;
+  u32 buffertopandbottom = getle32(footer+0);
+  u32 i, j;
+  u32 out = decompressedsize;
+  u32 index = compressedsize - ((buffertopandbottom>>24)&0xFF);
+  u32 segmentoffset;
+  u32 segmentsize;
+  u8 control;
+  u32 stopindex = compressedsize - (buffertopandbottom&0xFFFFFF);
+
+  memset(decompressed, 0, decompressedsize);
+  memcpy(decompressed, compressed, compressedsize);
+
+  while(index > stopindex)
+  {
+    control = compressed[--index];
+
+    for(i=0; i<8; i++)
+    {
+      if (index <= stopindex)
+        break;
+      if (index <= 0)
+        break;
+      if (out <= 0)
+        break;
+
+      if (control & 0x80)
+      {
+        if (index < 2)
+          return -1;
+
+        index -= 2;
+
+        segmentoffset = compressed[index] | (compressed[index+1]<<8);
+        segmentsize = ((segmentoffset >> 12)&15)+3;
+        segmentoffset &= 0x0FFF;
+        segmentoffset += 2;
+
+        if (out < segmentsize)
+          return -1;
+
+        for(j=0; j<segmentsize; j++)
+        {
+          u8 data;
+
+          if (out+segmentoffset >= decompressedsize)
+            return -1;
+
+          data  = decompressed[out+segmentoffset];
+          decompressed[--out] = data;
+        }
+      }
+      else
+      {
+        if (out < 1)
+          return -1;
+        decompressed[--out] = compressed[--index];
+      }
+
+      control <<= 1;
+    }
+  }
+
+  return 0;
+}
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t*
+read_file(const char *name, size_t *len)
+{
+  FILE    *fp = fopen(name, "rb");
+  uint8_t *data;
+  long    size;
+
+  if(!fp)
+    return NULL;
+
+  if(fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0
+  || fseek(fp, 0, SEEK_SET) != 0)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  data = malloc(size ? size : 1);
+  if(data && fread(data, 1, size, fp) != (size_t)size)
+  {
+    free(data);
+    data = NULL;
+  }
+
+  fclose(fp);
+  *len = size;
+  return data;
+}
+
+typedef struct
+{
+  const char *name;
+  void*      (*encode)(const void*, size_t, size_t*);
+} codec_t;
+
+static const codec_t codecs[] =
+{
+  { "LZ10", lzss_encode, },
+  { "LZ11", lz11_encode, },
+  { "BLZ",  blz_encode,  },
+};
+
+static int
+decode(int codec, int ref, uint8_t *src, size_t len, uint8_t *dst, size_t size)
+{
+  if(codec != 2)
+    src += compression_size(src, &size);
+
+  switch(codec)
+  {
+    case 0:
+      if(ref)
+        lzss_decode(src, dst, size);
+      else
+        lzss_decode_fast(src, dst, size);
+      return 0;
+
+    case 1:
+      if(ref)
+        lz11_decode(src, dst, size);
+      else
+        lz11_decode_fast(src, dst, size);
+      return 0;
+
+    default:
+      if(ref)
+        return lzss_decompress(src, len, dst, size);
+      return blz_decode(src, len, dst, size);
+  }
+}
+
+// best of several rounds of repeated decoding, to keep the noise down
+static double
+time_decode(int codec, int ref, uint8_t *src, size_t len, uint8_t *dst,
+            size_t size)
+{
+  double best = 0;
+  int    round;
+
+  for(round = 0; round < 8; ++round)
+  {
+    double   start = now(), elapsed, rate;
+    unsigned runs  = 0;
+
+    do
+    {
+      decode(codec, ref, src, len, dst, size);
+      ++runs;
+    } while((elapsed = now() - start) < 0.05);
+
+    rate = size * (double)runs / elapsed / 1e6;
+    if(rate > best)
+      best = rate;
+  }
+
+  return best;
+}
+
+int main(int argc, char *argv[])
+{
+  int argi, rc = EXIT_SUCCESS;
+
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-32s %-5s %10s %10s %10s %10s\n",
+         "file", "codec", "size", "packed", "ref MB/s", "fast MB/s");
+
+  for(argi = 1; argi < argc; ++argi)
+  {
+    uint8_t *data;
+    size_t  len;
+    int     codec;
+
+    data = read_file(argv[argi], &len);
+    if(!data)
+    {
+      fprintf(stderr, "%s: %s\n", argv[argi], strerror(errno));
+      rc = EXIT_FAILURE;
+      continue;
+    }
+
+    for(codec = 0; codec < (int)(sizeof(codecs) / sizeof(codecs[0])); ++codec)
+    {
+      uint8_t *packed, *ref = NULL, *out = NULL;
+      size_t  packed_len, size = len;
+
+      packed = codecs[codec].encode(data, len, &packed_len);
+      if(packed && codec == 2)
+      {
+        // stored rather than compressed; nothing to decode
+        if(blz_get32(packed + packed_len - 4) == 0)
+          goto next;
+
+        size = blz_decoded_size(packed, packed_len);
+      }
+
+      ref = calloc(size + 1, 1);
+      out = calloc(size + 1, 1);
+      if(!packed || !ref || !out)
+      {
+        fprintf(stderr, "%s: %s\n", argv[argi], strerror(ENOMEM));
+        rc = EXIT_FAILURE;
+        goto next;
+      }
+
+      if(decode(codec, 1, packed, packed_len, ref, size) != 0
+      || decode(codec, 0, packed, packed_len, out, size) != 0
+      || memcmp(ref, data, len) != 0
+      || memcmp(out, data, len) != 0)
+      {
+        fprintf(stderr, "%s: %s decoders disagree\n", argv[argi],
+                codecs[codec].name);
+        rc = EXIT_FAILURE;
+        goto next;
+      }
+
+      printf("%-32s %-5s %10zu %10zu %10.1f %10.1f\n", argv[argi],
+             codecs[codec].name, size, packed_len,
+             time_decode(codec, 1, packed, packed_len, ref, size),
+             time_decode(codec, 0, packed, packed_len, out, size));
+
+    next:
+      free(packed);
+      free(ref);
+      free(out);
+    }
+
+    free(data);
+  }
+
+  return rc;
+}
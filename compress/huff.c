@@ -0,0 +1,327 @@
+#define COMPRESSION_INTERNAL
+#include "compress.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Huffman coding, types 0x24 (4-bit symbols) and 0x28 (8-bit symbols).
+//
+// After the header:
+// - tree size byte: the tree table is (byte + 1) * 2 bytes long counting
+//   this byte, so that the bitstream after it stays word aligned
+// - tree table, root first. An internal node holds in bits 0-5 the offset
+//   of its pair of children, which sit at (address & ~1) + offset * 2 + 2
+//   and one past that, for a 0 and a 1 bit. Bit 7 (bit 6) is set if child
+//   0 (child 1) is a leaf, whose byte is the symbol.
+// - bitstream in little-endian words, each read from bit 31 down; 4-bit
+//   symbols come low nibble first
+
+#define HUFF_MAX_SYMBOLS 256
+#define HUFF_MAX_NODES   (2 * HUFF_MAX_SYMBOLS - 1)
+#define HUFF_MAX_OFFSET  0x3F
+
+typedef struct
+{
+  size_t   freq;
+  int      child[2]; // -1 for leaves
+  int      parent;
+  unsigned internal; // internal nodes in this subtree
+  uint8_t  symbol;
+} huff_node_t;
+
+typedef struct
+{
+  huff_node_t nodes[HUFF_MAX_NODES];
+  int         count;
+  int         root;
+  int         leaf[HUFF_MAX_SYMBOLS]; // node of each symbol, or -1
+} huff_tree_t;
+
+static int
+huff_add(huff_tree_t *tree, size_t freq, int child0, int child1, int symbol)
+{
+  huff_node_t *node = &tree->nodes[tree->count];
+
+  node->freq     = freq;
+  node->child[0] = child0;
+  node->child[1] = child1;
+  node->parent   = -1;
+  node->internal = 0;
+  node->symbol   = symbol;
+
+  if(child0 >= 0)
+  {
+    tree->nodes[child0].parent = tree->count;
+    tree->nodes[child1].parent = tree->count;
+    node->internal = 1 + tree->nodes[child0].internal
+                       + tree->nodes[child1].internal;
+  }
+
+  return tree->count++;
+}
+
+static void
+huff_build(huff_tree_t *tree, const size_t *freq, int symbols)
+{
+  int live[HUFF_MAX_SYMBOLS], nlive = 0, i;
+
+  tree->count = 0;
+  for(i = 0; i < symbols; ++i)
+  {
+    tree->leaf[i] = -1;
+    if(freq[i])
+      live[nlive++] = tree->leaf[i] = huff_add(tree, freq[i], -1, -1, i);
+  }
+
+  // the decoder needs at least two leaves
+  for(i = 0; nlive < 2; ++i)
+  {
+    if(tree->leaf[i] < 0)
+      live[nlive++] = tree->leaf[i] = huff_add(tree, 0, -1, -1, i);
+  }
+
+  while(nlive > 1)
+  {
+    int a = 0, b = 1, j;
+
+    if(tree->nodes[live[b]].freq < tree->nodes[live[a]].freq)
+    {
+      a = 1;
+      b = 0;
+    }
+
+    for(j = 2; j < nlive; ++j)
+    {
+      if(tree->nodes[live[j]].freq < tree->nodes[live[a]].freq)
+      {
+        b = a;
+        a = j;
+      }
+      else if(tree->nodes[live[j]].freq < tree->nodes[live[b]].freq)
+        b = j;
+    }
+
+    live[a] = huff_add(tree,
+                       tree->nodes[live[a]].freq + tree->nodes[live[b]].freq,
+                       live[a], live[b], 0);
+    live[b] = live[--nlive];
+  }
+
+  tree->root = live[0];
+}
+
+// Lay the tree out into table with the root at 1, and return the length
+// of the table so far, or 0 if some node ended up too far from its
+// children. Nodes waiting for their children are placed newest first, and
+// the smaller subtree of a pair before the larger, which keeps most offsets
+// small; the oldest one is placed as soon as its offset reaches limit.
+static size_t
+huff_layout(const huff_tree_t *tree, uint8_t *table, unsigned limit)
+{
+  int    node[HUFF_MAX_SYMBOLS];
+  size_t addr[HUFF_MAX_SYMBOLS], next = 2;
+  int    npending = 1;
+
+  node[0] = tree->root;
+  addr[0] = 1;
+
+  while(npending > 0)
+  {
+    const huff_node_t *parent;
+    size_t            offset, at;
+    int               k = npending - 1, first, i;
+
+    if((next - (addr[0] & ~1) - 2) / 2 >= limit)
+      k = 0;
+
+    offset = (next - (addr[k] & ~1) - 2) / 2;
+    if(offset > HUFF_MAX_OFFSET)
+      return 0;
+
+    parent = &tree->nodes[node[k]];
+    at     = addr[k];
+    memmove(node + k, node + k + 1, (npending - k - 1) * sizeof(*node));
+    memmove(addr + k, addr + k + 1, (npending - k - 1) * sizeof(*addr));
+    --npending;
+
+    table[at] = offset;
+
+    first = tree->nodes[parent->child[0]].internal
+         >= tree->nodes[parent->child[1]].internal ? 0 : 1;
+
+    for(i = 0; i < 2; ++i)
+    {
+      int               bit   = i ? !first : first;
+      const huff_node_t *child = &tree->nodes[parent->child[bit]];
+
+      if(child->child[0] < 0)
+      {
+        table[next + bit] = child->symbol;
+        table[at]        |= bit ? 0x40 : 0x80;
+      }
+      else
+      {
+        node[npending] = parent->child[bit];
+        addr[npending] = next + bit;
+        ++npending;
+      }
+    }
+
+    next += 2;
+  }
+
+  return next;
+}
+
+typedef struct
+{
+  buffer_t *result;
+  uint32_t word;
+  unsigned bits;
+} huff_writer_t;
+
+static int
+huff_flush(huff_writer_t *writer)
+{
+  uint8_t bytes[4] =
+  {
+    writer->word, writer->word >> 8, writer->word >> 16, writer->word >> 24,
+  };
+
+  writer->word = 0;
+  writer->bits = 0;
+  return buffer_push(writer->result, bytes, sizeof(bytes));
+}
+
+static int
+huff_put(huff_writer_t *writer, const huff_tree_t *tree, int symbol)
+{
+  uint8_t path[HUFF_MAX_SYMBOLS];
+  int     node = tree->leaf[symbol], depth = 0;
+
+  while(node != tree->root)
+  {
+    int parent = tree->nodes[node].parent;
+
+    path[depth++] = tree->nodes[parent].child[1] == node;
+    node          = parent;
+  }
+
+  while(depth-- > 0)
+  {
+    writer->word |= (uint32_t)path[depth] << (31 - writer->bits);
+    if(++writer->bits == 32 && huff_flush(writer) != 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+static void*
+huff_encode_bits(const uint8_t *input,
+                 size_t        len,
+                 size_t        *outlen,
+                 int           bits)
+{
+  huff_tree_t        *tree;
+  size_t             freq[HUFF_MAX_SYMBOLS] = { 0 }, i, table_len;
+  uint8_t            table[2 * HUFF_MAX_SYMBOLS], header[8];
+  size_t             header_len;
+  unsigned           limit;
+  buffer_t           result;
+  huff_writer_t      writer;
+
+  if(len > UINT32_MAX)
+    return NULL;
+
+  for(i = 0; i < len; ++i)
+  {
+    if(bits == 8)
+      ++freq[input[i]];
+    else
+    {
+      ++freq[input[i] & 0x0F];
+      ++freq[input[i] >> 4];
+    }
+  }
+
+  tree = malloc(sizeof(*tree));
+  if(!tree)
+    return NULL;
+
+  huff_build(tree, freq, 1 << bits);
+
+  for(limit = HUFF_MAX_OFFSET; ; --limit)
+  {
+    memset(table, 0, sizeof(table));
+    table_len = huff_layout(tree, table, limit);
+    if(table_len != 0)
+      break;
+    if(limit == 0)
+    {
+      free(tree);
+      return NULL;
+    }
+  }
+
+  table_len = (table_len + 3) & ~3;
+  table[0]  = table_len / 2 - 1;
+
+  buffer_init(&result);
+  header_len = compression_header(header, 0x20 | bits, len);
+  if(buffer_push(&result, header, header_len) != 0
+  || buffer_push(&result, table, table_len) != 0)
+    goto error;
+
+  writer.result = &result;
+  writer.word   = 0;
+  writer.bits   = 0;
+
+  for(i = 0; i < len; ++i)
+  {
+    if(bits == 8)
+    {
+      if(huff_put(&writer, tree, input[i]) != 0)
+        goto error;
+    }
+    else if(huff_put(&writer, tree, input[i] & 0x0F) != 0
+         || huff_put(&writer, tree, input[i] >> 4) != 0)
+      goto error;
+  }
+
+  if(writer.bits > 0 && huff_flush(&writer) != 0)
+    goto error;
+
+  free(tree);
+  *outlen = result.len;
+  return result.data;
+
+error:
+  free(tree);
+  buffer_destroy(&result);
+  return NULL;
+}
+
+void*
+huff_encode(const void *src,
+            size_t     len,
+            size_t     *outlen)
+{
+  size_t  len4, len8;
+  uint8_t *out4, *out8;
+
+  // 8-bit trees can fail to lay out; 4-bit ones never do
+  out8 = huff_encode_bits((const uint8_t*)src, len, &len8, 8);
+  out4 = huff_encode_bits((const uint8_t*)src, len, &len4, 4);
+
+  if(out8 && (!out4 || len8 <= len4))
+  {
+    free(out4);
+    *outlen = len8;
+    return out8;
+  }
+
+  free(out8);
+  *outlen = len4;
+  return out4;
+}
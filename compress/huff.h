@@ -0,0 +1,55 @@
+#pragma once
+
+// Huffman decoder for the 0x24 (4-bit) and 0x28 (8-bit) formats.
+// Header-only and free of libc calls so that the payloads can include it
+// directly; see huff.c for the format. src points past the header,
+// size is the decoded size and bits is the low nibble of the type byte.
+
+#include <stdint.h>
+
+static inline void
+huff_decode(const uint8_t *src, uint8_t *dst, uint32_t size, int bits)
+{
+  const uint8_t *tree = src;
+  const uint8_t *in   = src + (src[0] + 1) * 2;
+  uint8_t       *end  = dst + size;
+  uint32_t      pos   = 1, word = 0, mask = 0;
+  uint8_t       half  = 0, low = 0;
+
+  while(dst < end)
+  {
+    uint32_t child;
+    int      bit;
+
+    if(mask == 0)
+    {
+      word = in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+      in  += 4;
+      mask = 0x80000000;
+    }
+
+    bit    = (word & mask) != 0;
+    mask >>= 1;
+
+    child = (pos & ~1) + (tree[pos] & 0x3F) * 2 + 2 + bit;
+    if(!(tree[pos] & (bit ? 0x40 : 0x80)))
+    {
+      pos = child;
+      continue;
+    }
+
+    pos = 1;
+    if(bits == 8)
+      *dst++ = tree[child];
+    else if(!half)
+    {
+      low  = tree[child] & 0x0F;
+      half = 1;
+    }
+    else
+    {
+      *dst++ = low | (tree[child] << 4);
+      half   = 0;
+    }
+  }
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+// Resumable LZ11 decoder. Input and output can be handed over in pieces of
+// any size, and decoding stops wherever either runs out and picks up from
+// there on the next call. Header-only and free of libc calls so that the
+// payloads can include it directly.
+//
+// Matches are read either from the output itself, which must then be one
+// contiguous buffer filled chunk after chunk, or from a caller-supplied
+// window, in which case output chunks may be consumed and reused as soon as
+// they are returned.
+
+#include <stdint.h>
+
+enum
+{
+  LZ11_STREAM_ERROR = -1,
+  LZ11_STREAM_MORE  =  0, // needs more input or more output space
+  LZ11_STREAM_DONE  =  1,
+};
+
+typedef struct
+{
+  uint8_t  *window;      // NULL for direct output
+  uint32_t window_mask;
+  uint8_t  *next_out;    // where direct output must continue
+  uint32_t size;         // decoded size, once the header is in
+  uint32_t total;        // bytes decoded so far
+  uint32_t len;          // bytes left to copy of the current match
+  uint32_t disp;
+  uint8_t  state;
+  uint8_t  flags;
+  uint8_t  bits;         // flag bits left in flags
+  uint8_t  have;         // bytes collected in token
+  uint8_t  token[8];
+} lz11_stream_t;
+
+enum
+{
+  LZ11_STREAM_HEADER,
+  LZ11_STREAM_FLAGS,
+  LZ11_STREAM_TOKEN,
+  LZ11_STREAM_COPY,
+  LZ11_STREAM_END,
+};
+
+// window must be NULL or a power of two of at least 4096 bytes
+static inline int
+lz11_stream_init(lz11_stream_t *s, uint8_t *window, uint32_t window_size)
+{
+  if(window && (window_size < 4096 || (window_size & (window_size - 1))))
+    return -1;
+
+  s->window      = window;
+  s->window_mask = window_size - 1;
+  s->next_out    = 0;
+  s->size        = 0;
+  s->total       = 0;
+  s->len         = 0;
+  s->disp        = 0;
+  s->state       = LZ11_STREAM_HEADER;
+  s->flags       = 0;
+  s->bits        = 0;
+  s->have        = 0;
+  return 0;
+}
+
+// Decode from the *srclen bytes at src into the *dstlen bytes at dst, and
+// set both to the number of bytes used. Returns LZ11_STREAM_DONE once the
+// whole stream is decoded, LZ11_STREAM_MORE when it needs more input or
+// output space, or LZ11_STREAM_ERROR.
+static inline int
+lz11_stream_decode(lz11_stream_t *s,
+                   const uint8_t *src,
+                   uint32_t      *srclen,
+                   uint8_t       *dst,
+                   uint32_t      *dstlen)
+{
+  const uint8_t *in      = src, *in_end = src + *srclen;
+  uint8_t       *out     = dst, *out_end = dst + *dstlen;
+  int           rc       = LZ11_STREAM_MORE;
+
+  // direct output reads matches back from earlier chunks
+  if(!s->window && s->total && dst != s->next_out)
+    return LZ11_STREAM_ERROR;
+
+  for(;;)
+  {
+    switch(s->state)
+    {
+      case LZ11_STREAM_HEADER:
+        if(in == in_end)
+          goto suspend;
+
+        s->token[s->have++] = *in++;
+        if(s->have == 4)
+        {
+          if(s->token[0] != 0x11)
+            goto error;
+
+          s->size = s->token[1] | (s->token[2] << 8) | (s->token[3] << 16);
+        }
+        else if(s->have == 8)
+        {
+          // a zero 24-bit size is followed by a 32-bit one
+          s->size = s->token[4] | (s->token[5] << 8) | (s->token[6] << 16)
+                  | ((uint32_t)s->token[7] << 24);
+        }
+
+        if((s->have == 4 && s->size != 0) || s->have == 8)
+        {
+          s->have  = 0;
+          s->state = LZ11_STREAM_FLAGS;
+        }
+        break;
+
+      case LZ11_STREAM_FLAGS:
+        if(s->total == s->size)
+        {
+          s->state = LZ11_STREAM_END;
+          break;
+        }
+
+        if(s->bits == 0)
+        {
+          if(in == in_end)
+            goto suspend;
+
+          s->flags = *in++;
+          s->bits  = 8;
+        }
+
+        if(s->flags & 0x80)
+        {
+          s->state = LZ11_STREAM_TOKEN;
+          break;
+        }
+
+        // run of literals
+        while(out < out_end && in < in_end && s->bits > 0
+           && !(s->flags & 0x80) && s->total < s->size)
+        {
+          uint8_t c = *in++;
+
+          if(s->window)
+            s->window[s->total & s->window_mask] = c;
+          *out++ = c;
+          ++s->total;
+          s->flags <<= 1;
+          --s->bits;
+        }
+
+        if(s->bits > 0 && !(s->flags & 0x80) && s->total < s->size)
+          goto suspend;
+        break;
+
+      case LZ11_STREAM_TOKEN:
+      {
+        uint8_t need;
+
+        if(in == in_end)
+          goto suspend;
+
+        s->token[s->have++] = *in++;
+        switch(s->token[0] >> 4)
+        {
+          case 0:  need = 3; break;
+          case 1:  need = 4; break;
+          default: need = 2; break;
+        }
+
+        if(s->have < need)
+          break;
+
+        switch(need)
+        {
+          case 3:
+            s->len  = ((s->token[0] << 4) | (s->token[1] >> 4)) + 0x11;
+            break;
+          case 4:
+            s->len  = (((s->token[0] & 0x0F) << 12) | (s->token[1] << 4)
+                      | (s->token[2] >> 4)) + 0x111;
+            break;
+          default:
+            s->len  = (s->token[0] >> 4) + 1;
+            break;
+        }
+
+        s->disp = ((s->token[need-2] & 0x0F) << 8) | s->token[need-1];
+        if(s->disp >= s->total)
+          goto error;
+
+        if(s->len > s->size - s->total)
+          s->len = s->size - s->total;
+
+        s->have    = 0;
+        s->flags <<= 1;
+        --s->bits;
+        s->state   = LZ11_STREAM_COPY;
+        break;
+      }
+
+      case LZ11_STREAM_COPY:
+      {
+        uint32_t n = out_end - out;
+
+        if(n > s->len)
+          n = s->len;
+
+        s->len   -= n;
+        s->total += n;
+
+        if(s->window)
+        {
+          uint32_t pos = s->total - n, from = pos - s->disp - 1;
+
+          while(n-- > 0)
+          {
+            uint8_t c = s->window[from++ & s->window_mask];
+
+            s->window[pos++ & s->window_mask] = c;
+            *out++ = c;
+          }
+        }
+        else
+        {
+          const uint8_t *p = out - s->disp - 1;
+
+          while(n-- > 0)
+            *out++ = *p++;
+        }
+
+        if(s->len > 0)
+          goto suspend;
+
+        s->state = LZ11_STREAM_FLAGS;
+        break;
+      }
+
+      case LZ11_STREAM_END:
+        rc = LZ11_STREAM_DONE;
+        goto suspend;
+    }
+  }
+
+error:
+  rc = LZ11_STREAM_ERROR;
+
+suspend:
+  *srclen     = in - src;
+  *dstlen     = out - dst;
+  s->next_out = out;
+  return rc;
+}
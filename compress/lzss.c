@@ -6,18 +6,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define LZ10_MAX_LEN  18
-#define LZ10_MAX_DISP 4096
-
-#define LZ11_MAX_LEN  65808
-#define LZ11_MAX_DISP 4096
-
-typedef enum
-{
-  LZ10,
-  LZ11,
-} lzss_mode_t;
-
 const uint8_t*
 find_best_match(const uint8_t *start,
                 const uint8_t *buffer,
@@ -65,46 +53,305 @@ find_best_match(const uint8_t *start,
   return NULL;
 }
 
-static void*
-lzss_common_encode(const uint8_t *buffer,
-                   size_t        len,
-                   size_t        *outlen,
-                   lzss_mode_t   mode)
+static inline const uint8_t*
+find_match(hash_chain_t  *hc,
+           const uint8_t *start,
+           const uint8_t *buffer,
+           size_t        len,
+           size_t        max_disp,
+           size_t        *outlen)
 {
-  buffer_t      result;
-  const uint8_t *start = buffer;
-#ifndef NDEBUG
-  const uint8_t *end   = buffer + len;
-#endif
-  size_t        shift = 7, code_pos = 4;
+  if(hc != NULL)
+    return hash_chain_find(hc, buffer, len, outlen);
+
+  return find_best_match(start, buffer, len, max_disp, outlen);
+}
+
+void
+lzss_options_init(lzss_options_t *opts)
+{
+  opts->matcher = LZSS_MATCHER_HASH;
+  opts->parser  = LZSS_PARSER_GREEDY;
+  opts->lazy    = 1;
+
+  opts->threads    = 1;
+  opts->block_size = 256 * 1024;
+  opts->prime      = 1;
+}
+
+int
+lzss_writer_init(lzss_writer_t     *writer,
+                 lzss_mode_t       mode,
+                 size_t            len,
+                 const lzss_sink_t *sink)
+{
+  uint8_t header[8];
+  size_t  header_len = 0;
+
+  assert(mode == LZ10 || mode == LZ11 || mode == BLZ);
+
+  if(len > UINT32_MAX)
+    return -1;
+
+  if(mode != BLZ)
+    header_len = compression_header(header, mode == LZ10 ? 0x10 : 0x11, len);
+
+  writer->mode     = mode;
+  writer->shift    = 7;
+  writer->code_pos = header_len;
+  writer->sink     = sink;
+  writer->flushed  = 0;
+
+  buffer_init(&writer->result);
+
+  if(buffer_push(&writer->result, header, header_len) != 0
+  || buffer_push(&writer->result, NULL, 1) != 0)
+  {
+    buffer_destroy(&writer->result);
+    return -1;
+  }
+
+  writer->result.data[writer->code_pos] = 0;
+  return 0;
+}
+
+// hand everything so far to the sink
+static int
+lzss_writer_flush(lzss_writer_t *writer)
+{
+  if(writer->result.len == 0)
+    return 0;
+
+  if(writer->sink->write(writer->sink->ctx, writer->result.data,
+                         writer->result.len) != 0)
+    return -1;
+
+  writer->flushed   += writer->result.len;
+  writer->result.len = 0;
+  return 0;
+}
+
+#define LZSS_WRITER_FLUSH_SIZE 0x10000
+
+static inline int
+lzss_writer_next(lzss_writer_t *writer)
+{
+  if(writer->shift == 0)
+  {
+    // the flag group is complete
+    if(writer->sink && writer->result.len >= LZSS_WRITER_FLUSH_SIZE
+    && lzss_writer_flush(writer) != 0)
+      return -1;
+
+    writer->shift = 8;
+    if(buffer_push(&writer->result, NULL, 1) != 0)
+      return -1;
+
+    writer->code_pos = writer->result.len - 1;
+    writer->result.data[writer->code_pos] = 0;
+  }
+  --writer->shift;
+
+  return 0;
+}
+
+int
+lzss_writer_literal(lzss_writer_t *writer, uint8_t byte)
+{
+  if(buffer_push(&writer->result, &byte, 1) != 0)
+    return -1;
+
+  return lzss_writer_next(writer);
+}
+
+int
+lzss_writer_match(lzss_writer_t *writer, size_t len, size_t disp)
+{
+  buffer_t *result = &writer->result;
+
+  assert(disp >= lzss_min_disp(writer->mode));
+  disp -= lzss_min_disp(writer->mode);
+
+  if(writer->mode == LZ10 || writer->mode == BLZ)
+  {
+    assert(len >= 3 && len <= LZ10_MAX_LEN);
+    if(buffer_push(result, NULL, 2) != 0)
+      return -1;
 
-  const size_t  max_len  = mode == LZ10 ? LZ10_MAX_LEN  : LZ11_MAX_LEN;
-  const size_t  max_disp = mode == LZ10 ? LZ10_MAX_DISP : LZ11_MAX_DISP;
+    result->data[result->len-2] = ((len-3) << 4) | (disp >> 8);
+    result->data[result->len-1] = disp;
+  }
+  else if(len <= 16)
+  {
+    assert(len >= 3);
+    if(buffer_push(result, NULL, 2) != 0)
+      return -1;
 
-  uint8_t       header[4];
+    result->data[result->len-2] = ((len-0x1) << 4) | (disp >> 8);
+    result->data[result->len-1] = disp;
+  }
+  else if(len <= 272)
+  {
+    if(buffer_push(result, NULL, 3) != 0)
+      return -1;
 
-  if(mode == LZ10)
-    compression_header(header, 0x10, len);
+    result->data[result->len-3] = (len-0x11) >> 4;
+    result->data[result->len-2] = ((len-0x11) << 4) | (disp >> 8);
+    result->data[result->len-1] = disp;
+  }
   else
-    compression_header(header, 0x11, len);
+  {
+    assert(len <= LZ11_MAX_LEN);
+    if(buffer_push(result, NULL, 4) != 0)
+      return -1;
+
+    result->data[result->len-4] = (1 << 4) | (len-0x111) >> 12;
+    result->data[result->len-3] = (len-0x111) >> 4;
+    result->data[result->len-2] = ((len-0x111) << 4) | (disp >> 8);
+    result->data[result->len-1] = disp;
+  }
 
-  assert(mode == LZ10 || mode == LZ11);
+  result->data[writer->code_pos] |= (1 << writer->shift);
 
-  buffer_init(&result);
+  return lzss_writer_next(writer);
+}
+
+void*
+lzss_writer_finish(lzss_writer_t *writer, size_t *outlen)
+{
+  size_t pad = -(writer->flushed + writer->result.len) & 3;
 
-  if(buffer_push(&result, header, sizeof(header)) != 0)
+  if(buffer_push(&writer->result, NULL, pad) != 0
+  || (writer->sink && lzss_writer_flush(writer) != 0))
   {
-    buffer_destroy(&result);
+    buffer_destroy(&writer->result);
     return NULL;
   }
 
-  if(buffer_push(&result, NULL, 1) != 0)
+  *outlen = writer->flushed + writer->result.len;
+  return writer->result.data;
+}
+
+void
+lzss_writer_destroy(lzss_writer_t *writer)
+{
+  buffer_destroy(&writer->result);
+}
+
+// The greedy parser searches each position it lands on and the positions
+// it looks ahead to, and then lands on one of those. Searches are kept here
+// so that none is repeated. A result depends on the length asked for as
+// well as the position: near the end of the input the lookahead asks for
+// more than is left.
+#define MATCH_CACHE_SIZE 8
+
+typedef struct
+{
+  struct
   {
-    buffer_destroy(&result);
-    return NULL;
+    const uint8_t *buffer;
+    size_t        len;
+    const uint8_t *match;
+    size_t        match_len;
+  } entries[MATCH_CACHE_SIZE];
+  unsigned next;
+} match_cache_t;
+
+static void
+match_cache_init(match_cache_t *cache)
+{
+  memset(cache, 0, sizeof(*cache));
+}
+
+static const uint8_t*
+cached_find_match(match_cache_t *cache,
+                  hash_chain_t  *hc,
+                  const uint8_t *start,
+                  const uint8_t *buffer,
+                  size_t        len,
+                  size_t        max_disp,
+                  size_t        *outlen)
+{
+  unsigned i;
+
+  for(i = 0; i < MATCH_CACHE_SIZE; ++i)
+  {
+    if(cache->entries[i].buffer == buffer && cache->entries[i].len == len)
+    {
+      *outlen = cache->entries[i].match_len;
+      return cache->entries[i].match;
+    }
+  }
+
+  i = cache->next++ % MATCH_CACHE_SIZE;
+  cache->entries[i].buffer    = buffer;
+  cache->entries[i].len       = len;
+  cache->entries[i].match     = find_match(hc, start, buffer, len, max_disp,
+                                           &cache->entries[i].match_len);
+
+  *outlen = cache->entries[i].match_len;
+  return cache->entries[i].match;
+}
+
+// length covered by the token at buffer+skip, counting a literal as 1
+static size_t
+lookahead(match_cache_t *cache,
+          hash_chain_t  *hc,
+          const uint8_t *start,
+          const uint8_t *buffer,
+          size_t        skip,
+          size_t        len,
+          size_t        max_len,
+          size_t        max_disp)
+{
+  size_t match_len;
+
+  // nothing to match past the end of the input
+  if(skip >= len)
+    return 1;
+
+  cached_find_match(cache, hc, start, buffer+skip,
+                    len-skip < max_len ? len-skip : max_len, max_disp,
+                    &match_len);
+
+  return match_len < 3 ? 1 : match_len;
+}
+
+void*
+lzss_range_encode(const uint8_t        *start,
+                  const uint8_t        *buffer,
+                  size_t               len,
+                  size_t               *outlen,
+                  lzss_mode_t          mode,
+                  const lzss_options_t *opts,
+                  const lzss_sink_t    *sink)
+{
+  lzss_writer_t writer;
+  hash_chain_t  chain, *hc = NULL;
+  match_cache_t cache;
+#ifndef NDEBUG
+  const uint8_t *end   = buffer + len;
+#endif
+
+  const size_t  max_len  = lzss_max_len(mode);
+  const size_t  max_disp = lzss_max_disp(mode);
+
+  if(opts->parser == LZSS_PARSER_OPTIMAL)
+    return lzss_optimal_encode(start, buffer, len, outlen, mode, opts, sink);
+
+  // the scan matcher has no minimum displacement, so BLZ always hashes
+  if(opts->matcher == LZSS_MATCHER_HASH || mode == BLZ)
+  {
+    if(hash_chain_init(&chain, start, buffer + len - start,
+                       lzss_min_disp(mode), max_disp) != 0)
+      return NULL;
+    hc = &chain;
   }
-  
-  result.data[code_pos] = 0;
+
+  if(lzss_writer_init(&writer, mode, len, sink) != 0)
+    goto error_chain;
+
+  match_cache_init(&cache);
 
   while(len > 0)
   {
@@ -116,10 +363,9 @@ lzss_common_encode(const uint8_t *buffer,
 
     if(buffer != start)
     {
-      if(len < max_len)
-        tmp = find_best_match(start, buffer, len, max_disp, &tmplen);
-      else
-        tmp = find_best_match(start, buffer, max_len, max_disp, &tmplen);
+      tmp = cached_find_match(&cache, hc, start, buffer,
+                              len < max_len ? len : max_len, max_disp,
+                              &tmplen);
 
       if(tmp != NULL)
       {
@@ -134,119 +380,94 @@ lzss_common_encode(const uint8_t *buffer,
     else
       tmplen = 1;
 
-    if(tmplen > 2 && tmplen < len)
+    // Take a literal instead if that lets the next match cover as much.
+    // With two steps, follow both choices for one more token, and settle
+    // ties the one-step way.
+    if(opts->lazy > 0 && tmplen > 2 && tmplen < len)
     {
-      size_t skip_len, next_len;
+      size_t skip_len, next_len, skip_end, next_end;
+      int    literal;
 
-      if(len+1 < max_len)
-        find_best_match(start, buffer+1, len-1, max_disp, &skip_len);
-      else
-        find_best_match(start, buffer+1, max_len, max_disp, &skip_len);
-      if(skip_len < 3)
-        skip_len = 1;
+      skip_len = lookahead(&cache, hc, start, buffer, 1, len, max_len,
+                           max_disp);
+      next_len = lookahead(&cache, hc, start, buffer, tmplen, len, max_len,
+                           max_disp);
 
-      if(len+tmplen < max_len)
-        find_best_match(start, buffer+tmplen, len-tmplen, max_disp, &next_len);
-      else
-        find_best_match(start, buffer+tmplen, max_len, max_disp, &next_len);
-      if(next_len < 3)
-        next_len = 1;
+      literal  = tmplen + next_len <= skip_len + 1;
+      skip_end = 1 + skip_len;
+      next_end = tmplen + next_len;
+
+      if(opts->lazy > 1)
+      {
+        if(skip_end < len)
+          skip_end += lookahead(&cache, hc, start, buffer, skip_end, len,
+                                max_len, max_disp);
+        if(next_end < len)
+          next_end += lookahead(&cache, hc, start, buffer, next_end, len,
+                                max_len, max_disp);
+
+        literal = next_end < skip_end || (next_end == skip_end && literal);
+      }
 
-      if(tmplen + next_len <= skip_len + 1)
+      if(literal)
         tmplen = 1;
     }
 
     if(tmplen < 3)
     {
-      if(buffer_push(&result, buffer, 1) != 0)
-      {
-        buffer_destroy(&result);
-        return NULL;
-      }
+      if(lzss_writer_literal(&writer, *buffer) != 0)
+        goto error;
       tmplen = 1;
     }
-    else if(mode == LZ10)
-    {
-      if(buffer_push(&result, NULL, 2) != 0)
-      {
-        buffer_destroy(&result);
-        return NULL;
-      }
+    else if(lzss_writer_match(&writer, tmplen, buffer - tmp) != 0)
+      goto error;
 
-      result.data[code_pos] |= (1 << shift);
-      size_t disp = buffer - tmp - 1;
-      result.data[result.len-2] = ((tmplen-3) << 4) | (disp >> 8);
-      result.data[result.len-1] = disp;
-    }
-    else if(tmplen <= 16)
-    {
-      if(buffer_push(&result, NULL, 2) != 0)
-      {
-        buffer_destroy(&result);
-        return NULL;
-      }
+    buffer += tmplen;
+    len    -= tmplen;
+  }
 
-      result.data[code_pos] |= (1 << shift);
-      size_t disp = buffer - tmp - 1;
-      result.data[result.len-2] = ((tmplen-0x1) << 4) | (disp >> 8);
-      result.data[result.len-1] = disp;
-    }
-    else if(tmplen <= 272)
-    {
-      if(buffer_push(&result, NULL, 3) != 0)
-      {
-        buffer_destroy(&result);
-        return NULL;
-      }
+  if(hc != NULL)
+    hash_chain_destroy(hc);
 
-      result.data[code_pos] |= (1 << shift);
-      size_t disp = buffer - tmp - 1;
-      result.data[result.len-3] = (tmplen-0x11) >> 4;
-      result.data[result.len-2] = ((tmplen-0x11) << 4) | (disp >> 8);
-      result.data[result.len-1] = disp;
-    }
-    else
-    {
-      if(buffer_push(&result, NULL, 4) != 0)
-      {
-        buffer_destroy(&result);
-        return NULL;
-      }
+  return lzss_writer_finish(&writer, outlen);
 
-      result.data[code_pos] |= (1 << shift);
-      size_t disp = buffer - tmp - 1;
-      result.data[result.len-4] = (1 << 4) | (tmplen-0x111) >> 12;
-      result.data[result.len-3] = (tmplen-0x111) >> 4;
-      result.data[result.len-2] = ((tmplen-0x111) << 4) | (disp >> 8);
-      result.data[result.len-1] = disp;
-    }
+error:
+  lzss_writer_destroy(&writer);
+error_chain:
+  if(hc != NULL)
+    hash_chain_destroy(hc);
+  return NULL;
+}
 
-    buffer += tmplen;
-    len    -= tmplen;
+static void*
+lzss_common_encode(const uint8_t        *buffer,
+                   size_t               len,
+                   size_t               *outlen,
+                   lzss_mode_t          mode,
+                   const lzss_options_t *opts,
+                   const lzss_sink_t    *sink)
+{
+  if(opts->threads > 1 && len > opts->block_size)
+    return lzss_parallel_encode(buffer, len, outlen, mode, opts, sink);
 
-    if(shift == 0)
-    {
-      shift = 8;
-      if(buffer_push(&result, NULL, 1) != 0)
-      {
-        buffer_destroy(&result);
-        return NULL;
-      }
+  return lzss_range_encode(buffer, buffer, len, outlen, mode, opts, sink);
+}
 
-      code_pos = result.len - 1;
-      result.data[code_pos] = 0;
-    }
-    --shift;
-  }
+static size_t
+lzss_common_encode_to(const uint8_t        *buffer,
+                      size_t               len,
+                      const lzss_sink_t    *sink,
+                      lzss_mode_t          mode,
+                      const lzss_options_t *opts)
+{
+  size_t outlen;
+  void   *rest = lzss_common_encode(buffer, len, &outlen, mode, opts, sink);
 
-  if(buffer_pad(&result, 4) != 0)
-  {
-    buffer_destroy(&result);
-    return NULL;
-  }
+  if(!rest)
+    return 0;
 
-  *outlen = result.len;
-  return result.data;
+  free(rest);
+  return outlen;
 }
 
 void*
@@ -254,7 +475,28 @@ lzss_encode(const void *src,
             size_t     len,
             size_t     *outlen)
 {
-  return lzss_common_encode(src, len, outlen, LZ10);
+  lzss_options_t opts;
+
+  lzss_options_init(&opts);
+  return lzss_common_encode(src, len, outlen, LZ10, &opts, NULL);
+}
+
+void*
+lzss_encode_opts(const void           *src,
+                 size_t               len,
+                 size_t               *outlen,
+                 const lzss_options_t *opts)
+{
+  return lzss_common_encode(src, len, outlen, LZ10, opts, NULL);
+}
+
+size_t
+lzss_encode_to(const void           *src,
+               size_t               len,
+               const lzss_sink_t    *sink,
+               const lzss_options_t *opts)
+{
+  return lzss_common_encode_to(src, len, sink, LZ10, opts);
 }
 
 void*
@@ -262,7 +504,28 @@ lz11_encode(const void *src,
             size_t     len,
             size_t     *outlen)
 {
-  return lzss_common_encode(src, len, outlen, LZ11);
+  lzss_options_t opts;
+
+  lzss_options_init(&opts);
+  return lzss_common_encode(src, len, outlen, LZ11, &opts, NULL);
+}
+
+void*
+lz11_encode_opts(const void           *src,
+                 size_t               len,
+                 size_t               *outlen,
+                 const lzss_options_t *opts)
+{
+  return lzss_common_encode(src, len, outlen, LZ11, opts, NULL);
+}
+
+size_t
+lz11_encode_to(const void           *src,
+               size_t               len,
+               const lzss_sink_t    *sink,
+               const lzss_options_t *opts)
+{
+  return lzss_common_encode_to(src, len, sink, LZ11, opts);
 }
 
 void lzss_decode(const void *source, void *dest, size_t size)
@@ -0,0 +1,203 @@
+#pragma once
+
+// LZ10/LZ11 decoders that move whole words where the stream allows it,
+// for the payloads and the host alike. Header-only and free of libc calls.
+// Same interface as lzss_decode/lz11_decode: src points past the 4-byte
+// header and size is the decoded size.
+//
+// Wide stores may run up to 7 bytes past the end of a match; that is only
+// done while the output has room for it, and those bytes are overwritten by
+// what follows.
+
+#include <stdint.h>
+
+#define LZSS_FAST_SLACK 7
+
+static inline void
+lzss_fast_copy8(uint8_t *dst, const uint8_t *src)
+{
+  __builtin_memcpy(dst, src, 8);
+}
+
+// copy len bytes from dist bytes back, with dist >= 8
+static inline void
+lzss_fast_copy_far(uint8_t *dst, uint32_t dist, uint32_t len)
+{
+  const uint8_t *p = dst - dist;
+
+  for(;;)
+  {
+    lzss_fast_copy8(dst, p);
+    if(len <= 8)
+      break;
+
+    len -= 8;
+    dst += 8;
+    p   += 8;
+  }
+}
+
+// repeat the previous byte len times
+static inline void
+lzss_fast_fill(uint8_t *dst, uint32_t len)
+{
+  uint32_t v = dst[-1] * 0x01010101U;
+  uint8_t  pattern[8];
+
+  __builtin_memcpy(pattern,     &v, 4);
+  __builtin_memcpy(pattern + 4, &v, 4);
+
+  for(;;)
+  {
+    lzss_fast_copy8(dst, pattern);
+    if(len <= 8)
+      break;
+
+    len -= 8;
+    dst += 8;
+  }
+}
+
+// repeat the last dist bytes, 1 < dist < 8: lay down the first period
+// bytewise until the pattern spans a multiple of dist that is at least 8,
+// then copy from that far back
+static inline void
+lzss_fast_copy_near(uint8_t *dst, uint32_t dist, uint32_t len)
+{
+  const uint8_t *p = dst - dist;
+  uint32_t      step = dist * ((8 + dist - 1) / dist);
+  uint32_t      i;
+
+  for(i = 0; i < step && i < len; ++i)
+    dst[i] = p[i];
+
+  if(len > step)
+    lzss_fast_copy_far(dst + step, step, len - step);
+}
+
+// dst[0..len) = dst[-dist..), with room bytes of output from dst on; the
+// part that leaves room for the slack is copied wide, the rest bytewise
+static inline void
+lzss_fast_match(uint8_t *dst, uint32_t dist, uint32_t len, uint32_t room)
+{
+  const uint8_t *p;
+  uint32_t      wide = len;
+
+  if(room < len + LZSS_FAST_SLACK)
+    wide = len > LZSS_FAST_SLACK ? len - LZSS_FAST_SLACK : 0;
+
+  if(wide > 0)
+  {
+    if(dist >= 8)
+      lzss_fast_copy_far(dst, dist, wide);
+    else if(dist == 1)
+      lzss_fast_fill(dst, wide);
+    else
+      lzss_fast_copy_near(dst, dist, wide);
+  }
+
+  p    = dst + wide - dist;
+  dst += wide;
+  len -= wide;
+  while(len-- > 0)
+    *dst++ = *p++;
+}
+
+static inline void
+lzss_decode_fast(const uint8_t *src, uint8_t *dst, uint32_t size)
+{
+  uint8_t *end = dst + size;
+  int     i;
+  uint8_t flags;
+
+  while(dst < end)
+  {
+    flags = *src++;
+
+    // eight literals
+    if(flags == 0 && end - dst >= 8 + LZSS_FAST_SLACK)
+    {
+      lzss_fast_copy8(dst, src);
+      dst += 8;
+      src += 8;
+      continue;
+    }
+
+    for(i = 0; i < 8 && dst < end; i++, flags <<= 1)
+    {
+      if(flags & 0x80)
+      {
+        uint32_t len, disp, left = end - dst;
+
+        len  = (src[0] >> 4) + 3;
+        disp = ((src[0] & 0x0F) << 8) | src[1];
+        src += 2;
+
+        if(len > left)
+          len = left;
+
+        lzss_fast_match(dst, disp + 1, len, left);
+        dst += len;
+      }
+      else
+        *dst++ = *src++;
+    }
+  }
+}
+
+static inline void
+lz11_decode_fast(const uint8_t *src, uint8_t *dst, uint32_t size)
+{
+  uint8_t *end = dst + size;
+  int     i;
+  uint8_t flags;
+
+  while(dst < end)
+  {
+    flags = *src++;
+
+    // eight literals
+    if(flags == 0 && end - dst >= 8 + LZSS_FAST_SLACK)
+    {
+      lzss_fast_copy8(dst, src);
+      dst += 8;
+      src += 8;
+      continue;
+    }
+
+    for(i = 0; i < 8 && dst < end; i++, flags <<= 1)
+    {
+      if(flags & 0x80)
+      {
+        uint32_t len, disp, left = end - dst;
+
+        switch(src[0] >> 4)
+        {
+          case 0:
+            len  = ((src[0] << 4) | (src[1] >> 4)) + 0x11;
+            src += 1;
+            break;
+          case 1:
+            len  = (((src[0] & 0x0F) << 12) | (src[1] << 4) | (src[2] >> 4))
+                 + 0x111;
+            src += 2;
+            break;
+          default:
+            len  = (src[0] >> 4) + 1;
+            break;
+        }
+
+        disp = ((src[0] & 0x0F) << 8) | src[1];
+        src += 2;
+
+        if(len > left)
+          len = left;
+
+        lzss_fast_match(dst, disp + 1, len, left);
+        dst += len;
+      }
+      else
+        *dst++ = *src++;
+    }
+  }
+}
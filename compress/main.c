@@ -1,96 +1,600 @@
 #include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include "compress.h"
 
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options] [input [output]]\n"
+          "  --lz10|--lz11|--blz|--rle|--huff\n"
+          "                       output format (default lz11)\n"
+          "  --auto               try lz10, lz11, rle and huff, keep the smallest\n"
+          "  --chain              with --auto, also try two formats in a row;\n"
+          "                       the output then has to be decoded twice\n"
+          "  --matcher=hash|scan  match finder\n"
+          "  --optimal            minimum-size parse\n"
+          "  --lazy=0|1|2         greedy lookahead steps (default 1)\n"
+          "  --threads=N          compress blocks on N threads\n"
+          "  --block-size=N       bytes per block (default 262144)\n"
+          "  --no-prime           restart the window at every block\n"
+          "  --stats              print ratio and speed\n"
+          "  --verify             decode the output again and compare\n",
+          prog);
+}
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// random piece sizes, mostly small so that decoding is suspended often
+static uint32_t
+piece(size_t left)
+{
+  uint32_t n = rand() % 4 ? rand() % 17 : rand() % 4096;
+  return n < left ? n : left;
+}
+
+// Feed an LZ11 stream to the resumable decoder in random pieces, writing
+// either straight to the output or through a window into a scratch buffer
+// that is overwritten each time.
+static int
+verify_lz11_stream(const uint8_t *packed,
+                   size_t        packed_len,
+                   uint8_t       *out,
+                   size_t        len,
+                   int           windowed)
+{
+  static uint8_t window[4096], scratch[4096];
+  lz11_stream_t  s;
+  size_t         in_pos = 0, out_pos = 0;
+  int            rc = LZ11_STREAM_MORE, stalled = 0;
+
+  lz11_stream_init(&s, windowed ? window : NULL, sizeof(window));
+
+  while(rc == LZ11_STREAM_MORE && stalled < 1000)
+  {
+    uint32_t srclen = piece(packed_len - in_pos);
+    uint32_t dstlen = piece(len - out_pos);
+    uint8_t  *dst   = windowed ? scratch : out + out_pos;
+
+    rc = lz11_stream_decode(&s, packed + in_pos, &srclen, dst, &dstlen);
+    if(windowed)
+      memcpy(out + out_pos, scratch, dstlen);
+
+    stalled  = srclen || dstlen ? 0 : stalled + 1;
+    in_pos  += srclen;
+    out_pos += dstlen;
+  }
+
+  return rc == LZ11_STREAM_DONE && out_pos == len ? 0 : -1;
+}
+
+// Decode one layer of the headered formats, checking the LZ11 stream
+// decoder on the way. Returns NULL if the type is unknown or the decoders
+// disagree.
+static uint8_t*
+unpack(const uint8_t *packed, size_t packed_len, size_t *outlen)
+{
+  size_t  len, header_len = compression_size(packed, &len);
+  uint8_t *out, *scratch = NULL;
+  int     rc = 0;
+
+  out = malloc(len + 1);
+  if(!out)
+    return NULL;
+
+  switch(packed[0])
+  {
+    case 0x10:
+      lzss_decode(packed + header_len, out, len);
+      break;
+
+    case 0x11:
+      lz11_decode(packed + header_len, out, len);
+      scratch = malloc(len + 1);
+      rc = !scratch
+        || verify_lz11_stream(packed, packed_len, scratch, len, 0) != 0
+        || memcmp(scratch, out, len) != 0
+        || verify_lz11_stream(packed, packed_len, scratch, len, 1) != 0
+        || memcmp(scratch, out, len) != 0;
+      free(scratch);
+      break;
+
+    case 0x24:
+    case 0x28:
+      huff_decode(packed + header_len, out, len, packed[0] & 0x0F);
+      break;
+
+    case 0x30:
+      rle_decode(packed + header_len, out, len);
+      break;
+
+    default:
+      rc = -1;
+      break;
+  }
+
+  if(rc != 0)
+  {
+    free(out);
+    return NULL;
+  }
+
+  *outlen = len;
+  return out;
+}
+
+// decode the output again, layers times for the headered formats
+static int
+verify(const char    *format,
+       int           layers,
+       const uint8_t *packed,
+       size_t        packed_len,
+       const uint8_t *data,
+       size_t        len)
+{
+  uint8_t *out;
+  size_t  out_len = packed_len;
+  int     rc;
+
+  // every format but BLZ has at least one header to decode
+  if(layers < 1)
+    return -1;
+
+  if(strcmp(format, "BLZ") == 0)
+  {
+    out = malloc(len > packed_len ? len : packed_len);
+    if(!out)
+      return -1;
+
+    memcpy(out, packed, packed_len);
+    rc = blz_decode(out, packed_len, out, len > packed_len ? len : packed_len);
+    out_len = len;
+  }
+  else
+  {
+    const uint8_t *in = packed;
+
+    for(rc = 0; rc < layers; ++rc)
+    {
+      out = unpack(in, out_len, &out_len);
+      if(in != packed)
+        free((uint8_t*)in);
+      if(!out)
+        return -1;
+      in = out;
+    }
+
+    rc = 0;
+  }
+
+  if(rc != 0 || out_len != len || memcmp(out, data, len) != 0)
+    rc = -1;
+
+  free(out);
+  return rc;
+}
+
+static void*
+rle_encode_opts(const void           *src,
+                size_t               len,
+                size_t               *outlen,
+                const lzss_options_t *opts)
+{
+  (void)opts;
+  return rle_encode(src, len, outlen);
+}
+
+static void*
+huff_encode_opts(const void           *src,
+                 size_t               len,
+                 size_t               *outlen,
+                 const lzss_options_t *opts)
+{
+  (void)opts;
+  return huff_encode(src, len, outlen);
+}
+
+typedef void* (*encode_t)(const void*, size_t, size_t*, const lzss_options_t*);
+
+static const struct
+{
+  const char *name;
+  encode_t   encode;
+} formats[] =
+{
+  { "LZ10", lzss_encode_opts, },
+  { "LZ11", lz11_encode_opts, },
+  { "RLE",  rle_encode_opts,  },
+  { "HUFF", huff_encode_opts, },
+};
+
+#define NUM_FORMATS (sizeof(formats) / sizeof(formats[0]))
+
+// keep result if it is smaller than *best
+static void
+keep_smaller(uint8_t **best, size_t *best_len, uint8_t *result, size_t len,
+             int *best_layers, int layers, char *name, const char *first,
+             const char *second)
+{
+  if(!result)
+    return;
+
+  if(*best && *best_len <= len)
+  {
+    free(result);
+    return;
+  }
+
+  free(*best);
+  *best        = result;
+  *best_len    = len;
+  *best_layers = layers;
+  if(second)
+    sprintf(name, "%s+%s", first, second);
+  else
+    strcpy(name, first);
+}
+
+// Try every format and, with chain set, every pair of different formats
+// one after the other, and return the smallest output. name is set to the
+// format or formats used, in the order they were applied, and layers to
+// how many times the output must be decoded.
+static uint8_t*
+auto_encode(const uint8_t        *data,
+            size_t               len,
+            size_t               *outlen,
+            const lzss_options_t *opts,
+            int                  chain,
+            char                 *name,
+            int                  *layers)
+{
+  uint8_t *best = NULL;
+  size_t  i, j;
+
+  for(i = 0; i < NUM_FORMATS; ++i)
+  {
+    uint8_t *first;
+    size_t  first_len;
+
+    first = formats[i].encode(data, len, &first_len, opts);
+    if(!first)
+      continue;
+
+    for(j = 0; chain && j < NUM_FORMATS; ++j)
+    {
+      uint8_t *second;
+      size_t  second_len;
+
+      if(j == i)
+        continue;
+
+      second = formats[j].encode(first, first_len, &second_len, opts);
+      keep_smaller(&best, outlen, second, second_len, layers, 2, name,
+                   formats[i].name, formats[j].name);
+    }
+
+    keep_smaller(&best, outlen, first, first_len, layers, 1, name,
+                 formats[i].name, NULL);
+  }
+
+  return best;
+}
+
+// The whole input, mapped if it is a regular file and read into a growing
+// buffer otherwise.
+typedef struct
+{
+  uint8_t *data;
+  size_t  len;
+  int     mapped;
+} input_t;
+
+static int
+input_open(input_t *input, const char *name)
+{
+  int         fd = name ? open(name, O_RDONLY) : STDIN_FILENO;
+  size_t      limit = 0;
+  ssize_t     rc;
+  struct stat st;
+
+  input->data   = NULL;
+  input->len    = 0;
+  input->mapped = 0;
+
+  if(fd < 0)
+    return -1;
+
+  if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(data != MAP_FAILED)
+    {
+      input->data   = data;
+      input->len    = st.st_size;
+      input->mapped = 1;
+      if(name)
+        close(fd);
+      return 0;
+    }
+  }
+
+  for(;;)
+  {
+    if(input->len == limit)
+    {
+      uint8_t *data;
+
+      limit = limit ? limit * 2 : 0x10000;
+      data  = realloc(input->data, limit);
+      if(!data)
+      {
+        errno = ENOMEM;
+        break;
+      }
+      input->data = data;
+    }
+
+    rc = read(fd, input->data + input->len, limit - input->len);
+    if(rc < 0 && errno == EINTR)
+      continue;
+    else if(rc < 0)
+      break;
+    else if(rc == 0)
+    {
+      if(name)
+        close(fd);
+      return 0;
+    }
+    else
+      input->len += rc;
+  }
+
+  rc = errno;
+  if(name)
+    close(fd);
+  free(input->data);
+  errno = rc;
+  return -1;
+}
+
+static void
+input_close(input_t *input)
+{
+  if(input->mapped)
+    munmap(input->data, input->len);
+  else
+    free(input->data);
+}
+
+static int
+file_write(void *ctx, const void *data, size_t len)
+{
+  return fwrite(data, 1, len, (FILE*)ctx) == len ? 0 : -1;
+}
+
+typedef size_t (*encode_to_t)(const void*, size_t, const lzss_sink_t*,
+                              const lzss_options_t*);
+
 int main(int argc, char *argv[])
 {
-  static unsigned char buffer[0xFFFFFF];
-  size_t               inlen = 0, outlen;
-  ssize_t              rc;
-  uint8_t              *result;
-  FILE                 *in_file = stdin, *out_file = stdout;
+  size_t               outlen;
+  uint8_t              *result = NULL;
+  FILE                 *out_file = stdout;
   const char           *in_name = "stdin", *out_name = "stdout";
+  char                 *tmp_name = NULL;
+  input_t              input, packed;
+  lzss_options_t       opts;
+  int                  argi = 1, stats = 0, check = 0;
+  int                  automatic = 0, chain = 0, layers = 1, rc;
+  double               elapsed;
+  char                 auto_format[16];
+  const char           *format = "LZ11";
+  encode_t             encode = lz11_encode_opts;
+  encode_to_t          encode_to = lz11_encode_to;
+  lzss_sink_t          sink;
+  struct stat          st;
 
-  if(argc > 1)
+  lzss_options_init(&opts);
+
+  for(; argi < argc && strncmp(argv[argi], "--", 2) == 0; ++argi)
   {
-    in_name = argv[1];
-    in_file = fopen(in_name, "rb");
-    if(!in_file)
+    if(strcmp(argv[argi], "--lz10") == 0)
     {
-      fprintf(stderr, "fopen %s: %s\n", in_name, strerror(errno));
+      format    = "LZ10";
+      encode    = lzss_encode_opts;
+      encode_to = lzss_encode_to;
+    }
+    else if(strcmp(argv[argi], "--lz11") == 0)
+    {
+      format    = "LZ11";
+      encode    = lz11_encode_opts;
+      encode_to = lz11_encode_to;
+    }
+    else if(strcmp(argv[argi], "--blz") == 0)
+    {
+      format    = "BLZ";
+      encode    = blz_encode_opts;
+      encode_to = NULL;
+    }
+    else if(strcmp(argv[argi], "--rle") == 0)
+    {
+      format    = "RLE";
+      encode    = rle_encode_opts;
+      encode_to = NULL;
+    }
+    else if(strcmp(argv[argi], "--huff") == 0)
+    {
+      format    = "HUFF";
+      encode    = huff_encode_opts;
+      encode_to = NULL;
+    }
+    else if(strcmp(argv[argi], "--auto") == 0)
+      automatic = 1;
+    else if(strcmp(argv[argi], "--chain") == 0)
+      chain = 1;
+    else if(strcmp(argv[argi], "--matcher=hash") == 0)
+      opts.matcher = LZSS_MATCHER_HASH;
+    else if(strcmp(argv[argi], "--matcher=scan") == 0)
+      opts.matcher = LZSS_MATCHER_SCAN;
+    else if(strcmp(argv[argi], "--optimal") == 0)
+      opts.parser = LZSS_PARSER_OPTIMAL;
+    else if(strncmp(argv[argi], "--lazy=", 7) == 0
+         && argv[argi][7] >= '0' && argv[argi][7] <= '2' && !argv[argi][8])
+      opts.lazy = argv[argi][7] - '0';
+    else if(strncmp(argv[argi], "--threads=", 10) == 0
+         && atoi(argv[argi] + 10) > 0)
+      opts.threads = atoi(argv[argi] + 10);
+    else if(strncmp(argv[argi], "--block-size=", 13) == 0
+         && strtoul(argv[argi] + 13, NULL, 0) > 0)
+      opts.block_size = strtoul(argv[argi] + 13, NULL, 0);
+    else if(strcmp(argv[argi], "--no-prime") == 0)
+      opts.prime = 0;
+    else if(strcmp(argv[argi], "--stats") == 0)
+      stats = 1;
+    else if(strcmp(argv[argi], "--verify") == 0)
+      check = 1;
+    else
+    {
+      usage(argv[0]);
       return EXIT_FAILURE;
     }
   }
 
+  argc -= argi - 1;
+  argv += argi - 1;
+
+  if(argc > 1)
+    in_name = argv[1];
+
+  if(input_open(&input, argc > 1 ? in_name : NULL) != 0)
+  {
+    fprintf(stderr, "open %s: %s\n", in_name, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  // Regular files are written under a temporary name and renamed over the
+  // output at the end, so that the output may replace the input
   if(argc > 2)
   {
     out_name = argv[2];
-    out_file = fopen(out_name, "wb");
-    if(!out_file)
+    if(stat(out_name, &st) != 0 || S_ISREG(st.st_mode))
     {
-      fprintf(stderr, "fopen %s: %s\n", out_name, strerror(errno));
-      fclose(in_file);
-      return EXIT_FAILURE;
+      tmp_name = malloc(strlen(out_name) + 5);
+      if(!tmp_name)
+      {
+        fprintf(stderr, "%s: %s\n", out_name, strerror(ENOMEM));
+        return EXIT_FAILURE;
+      }
+      sprintf(tmp_name, "%s.tmp", out_name);
     }
-  }
 
-  while(inlen < sizeof(buffer))
-  {
-    rc = fread(buffer+inlen, 1, sizeof(buffer)-inlen, in_file);
-    if(rc < 0)
+    out_file = fopen(tmp_name ? tmp_name : out_name, "wb");
+    if(!out_file)
     {
-      fprintf(stderr, "fread %s: %s\n", in_name, strerror(errno));
-      fclose(in_file);
-      fclose(out_file);
+      fprintf(stderr, "fopen %s: %s\n", tmp_name ? tmp_name : out_name,
+              strerror(errno));
       return EXIT_FAILURE;
     }
-    else if(rc == 0)
-      break;
-    else
-      inlen += rc;
   }
 
-  if(!feof(in_file))
+  // LZ10 and LZ11 go out as they are encoded, unless the output has to be
+  // kept for --verify and cannot be read back
+  if(automatic || (check && !tmp_name))
+    encode_to = NULL;
+
+  elapsed = now();
+  if(encode_to)
   {
-    fprintf(stderr, "File too large\n");
-    fclose(in_file);
-    return EXIT_FAILURE;
+    sink.write = file_write;
+    sink.ctx   = out_file;
+    outlen     = encode_to(input.data, input.len, &sink, &opts);
+    rc         = outlen == 0 ? (ferror(out_file) ? errno : ENOMEM) : 0;
+  }
+  else if(automatic)
+  {
+    result = auto_encode(input.data, input.len, &outlen, &opts, chain,
+                         auto_format, &layers);
+    format = auto_format;
+    rc     = result ? 0 : ENOMEM;
   }
+  else
+  {
+    result = (uint8_t*)encode(input.data, input.len, &outlen, &opts);
+    rc     = result ? 0 : ENOMEM;
+    if(!result && encode == blz_encode_opts && input.len >= BLZ_MAX_INPUT)
+      rc = EFBIG;
+  }
+  elapsed = now() - elapsed;
 
-  fclose(in_file);
+  if(rc == 0 && result && fwrite(result, 1, outlen, out_file) != outlen)
+    rc = errno;
 
-  result = (uint8_t*)lz11_encode(buffer, inlen, &outlen);
-  if(!result)
+  if(fclose(out_file) != 0 && rc == 0)
+    rc = errno;
+
+  if(rc != 0)
   {
-    fprintf(stderr, "Failed to compress %s: %s\n", in_name, strerror(ENOMEM));
-    fclose(out_file);
+    fprintf(stderr, "Failed to compress %s: %s\n", in_name, strerror(rc));
+    if(tmp_name)
+      remove(tmp_name);
     return EXIT_FAILURE;
   }
 
-  inlen = 0;
-  while(inlen < outlen)
+  if(check)
   {
-    rc = fwrite(result+inlen, 1, outlen-inlen, out_file);
-    if(rc < 0)
+    if(result)
+      rc = verify(format, layers, result, outlen, input.data, input.len);
+    else if((rc = input_open(&packed, tmp_name)) == 0)
+    {
+      rc = verify(format, layers, packed.data, packed.len, input.data,
+                  input.len);
+      input_close(&packed);
+    }
+
+    if(rc != 0)
     {
-      fprintf(stderr, "fwrite %s: %s\n", out_name, strerror(errno));
-      fclose(out_file);
+      fprintf(stderr, "Failed to verify %s\n", in_name);
+      if(tmp_name)
+        remove(tmp_name);
       return EXIT_FAILURE;
     }
-    else if(rc > 0)
-      inlen += rc;
   }
 
-  if(fclose(out_file) != 0)
+  if(tmp_name && rename(tmp_name, out_name) != 0)
   {
-    fprintf(stderr, "fclose %s: %s\n", out_name, strerror(errno));
+    fprintf(stderr, "rename %s: %s\n", out_name, strerror(errno));
+    remove(tmp_name);
     return EXIT_FAILURE;
   }
 
-  fprintf(stderr, "LZ11 Compressed %zu -> %zu bytes\n", rc, outlen);
+  fprintf(stderr, "%s Compressed %zu -> %zu bytes\n", format, input.len,
+          outlen);
+
+  if(stats)
+  {
+    fprintf(stderr, "%u thread(s), %zu byte blocks%s: ratio %.4f, %.3f s, %.2f MB/s\n",
+            opts.threads, opts.block_size, opts.prime ? " (primed)" : "",
+            input.len ? (double)outlen / input.len : 0.0, elapsed,
+            elapsed > 0 ? input.len / elapsed / 1e6 : 0.0);
+  }
 
+  free(result);
+  free(tmp_name);
+  input_close(&input);
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,231 @@
+#define COMPRESSION_INTERNAL
+#include "compress.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_CHAIN_NIL UINT32_MAX
+
+// positions are only ever looked up within max_disp behind a query, but the
+// encoder's lookahead can insert up to one max length ahead of it
+#define HASH_CHAIN_RING_BITS 17
+#define HASH_CHAIN_RING_SIZE (1 << HASH_CHAIN_RING_BITS)
+#define HASH_CHAIN_RING_MASK (HASH_CHAIN_RING_SIZE - 1)
+
+static inline uint8_t
+hash_chain_byte(const hash_chain_t *hc, const uint8_t *p)
+{
+  // the last two positions hash as if the input went on with zeros
+  return p < hc->end ? *p : 0;
+}
+
+static inline uint32_t
+hash_chain_hash(const hash_chain_t *hc, const uint8_t *p)
+{
+  uint32_t v;
+
+  if(p + 3 <= hc->end)
+    v = (p[0] << 16) | (p[1] << 8) | p[2];
+  else
+    v = (hash_chain_byte(hc, p)   << 16)
+      | (hash_chain_byte(hc, p+1) <<  8)
+      |  hash_chain_byte(hc, p+2);
+
+  return (v * 2654435761U) >> (32 - HASH_CHAIN_HASH_BITS);
+}
+
+static inline void
+hash_chain_insert(hash_chain_t *hc, uint32_t pos)
+{
+  uint32_t h = hash_chain_hash(hc, hc->start + pos);
+
+  hc->prev[pos & HASH_CHAIN_RING_MASK] = hc->head[h];
+  hc->head[h] = pos;
+}
+
+// the first known bytes are already known to match
+static inline size_t
+hash_chain_match_len(const hash_chain_t *hc,
+                     const uint8_t      *p,
+                     const uint8_t      *buffer,
+                     size_t             len,
+                     size_t             known)
+{
+  size_t avail = hc->end - buffer;
+  size_t n     = len < avail ? len : avail;
+  size_t i     = known < n ? known : n;
+
+  while(i + sizeof(uint64_t) <= n)
+  {
+    uint64_t a, b;
+    memcpy(&a, p + i, sizeof(a));
+    memcpy(&b, buffer + i, sizeof(b));
+    if(a != b)
+      break;
+    i += sizeof(uint64_t);
+  }
+
+  while(i < n && p[i] == buffer[i])
+    ++i;
+
+  return i;
+}
+
+int
+hash_chain_init(hash_chain_t  *hc,
+                const uint8_t *start,
+                size_t        len,
+                size_t        min_disp,
+                size_t        max_disp)
+{
+  assert(max_disp < HASH_CHAIN_RING_SIZE);
+
+  if(len >= HASH_CHAIN_NIL)
+    return -1;
+
+  hc->start    = start;
+  hc->end      = start + len;
+  hc->min_disp = min_disp;
+  hc->max_disp = max_disp;
+  hc->inserted = 0;
+  hc->head     = malloc(sizeof(uint32_t) << HASH_CHAIN_HASH_BITS);
+  hc->prev     = malloc(sizeof(uint32_t) * HASH_CHAIN_RING_SIZE);
+
+  if(!hc->head || !hc->prev)
+  {
+    hash_chain_destroy(hc);
+    return -1;
+  }
+
+  memset(hc->head, 0xFF, sizeof(uint32_t) << HASH_CHAIN_HASH_BITS);
+  return 0;
+}
+
+void
+hash_chain_destroy(hash_chain_t *hc)
+{
+  free(hc->head);
+  free(hc->prev);
+  hc->head = NULL;
+  hc->prev = NULL;
+}
+
+const uint8_t*
+hash_chain_find(hash_chain_t  *hc,
+                const uint8_t *buffer,
+                size_t        len,
+                size_t        *outlen)
+{
+  const uint8_t *best_start = NULL;
+  size_t        best_len    = 0;
+  uint32_t      pos         = buffer - hc->start;
+  uint32_t      min_pos     = pos > hc->max_disp ? pos - hc->max_disp : 0;
+  uint32_t      cand;
+
+  assert(len <= (size_t)(hc->end - buffer));
+
+  // matches shorter than 3 are never encoded, so they are not indexed
+  if(len < 3 || pos == 0)
+  {
+    *outlen = 0;
+    return NULL;
+  }
+
+  while(hc->inserted < pos)
+    hash_chain_insert(hc, hc->inserted++);
+
+  assert(hc->inserted - min_pos <= HASH_CHAIN_RING_SIZE);
+
+  // walk from the nearest candidate to the farthest, keeping the same
+  // tie-break as find_best_match: the nearest match that reaches len wins,
+  // otherwise the farthest of the longest
+  cand = hc->head[hash_chain_hash(hc, buffer)];
+  while(cand != HASH_CHAIN_NIL && cand >= min_pos)
+  {
+    if(cand + hc->min_disp <= pos)
+    {
+      const uint8_t *p        = hc->start + cand;
+      size_t        test_len = hash_chain_match_len(hc, p, buffer, len, 0);
+
+      if(test_len >= 3 && test_len >= best_len)
+      {
+        best_start = p;
+        best_len   = test_len;
+
+        if(best_len == len)
+          break;
+      }
+    }
+
+    cand = hc->prev[cand & HASH_CHAIN_RING_MASK];
+  }
+
+  *outlen = best_len;
+  return best_start;
+}
+
+const uint8_t*
+hash_chain_longest(hash_chain_t  *hc,
+                   const uint8_t *buffer,
+                   size_t        len,
+                   const uint8_t *hint,
+                   size_t        hint_len,
+                   size_t        *outlen)
+{
+  const uint8_t *best_start = NULL;
+  size_t        best_len    = 2;
+  uint32_t      pos         = buffer - hc->start;
+  uint32_t      min_pos     = pos > hc->max_disp ? pos - hc->max_disp : 0;
+  uint32_t      cand;
+
+  assert(len <= (size_t)(hc->end - buffer));
+
+  if(len < 3 || pos == 0)
+  {
+    *outlen = 0;
+    return NULL;
+  }
+
+  while(hc->inserted < pos)
+    hash_chain_insert(hc, hc->inserted++);
+
+  // seed with the caller's guess (usually the previous position's match
+  // source, advanced by one) so most candidates fail the quick check below;
+  // hint_len of it is known to match, which keeps runs linear
+  if(hint != NULL && hint + hc->min_disp <= buffer
+  && hint >= hc->start + min_pos)
+  {
+    size_t test_len = hash_chain_match_len(hc, hint, buffer, len, hint_len);
+    if(test_len > best_len)
+    {
+      best_start = hint;
+      best_len   = test_len;
+    }
+  }
+
+  cand = hc->head[hash_chain_hash(hc, buffer)];
+  while(best_len < len && cand != HASH_CHAIN_NIL && cand >= min_pos)
+  {
+    const uint8_t *p = hc->start + cand;
+
+    // only a candidate that also matches the byte at best_len can do better
+    if(cand + hc->min_disp <= pos && p[best_len] == buffer[best_len])
+    {
+      size_t test_len = hash_chain_match_len(hc, p, buffer, len, 0);
+      if(test_len > best_len)
+      {
+        best_start = p;
+        best_len   = test_len;
+      }
+    }
+
+    cand = hc->prev[cand & HASH_CHAIN_RING_MASK];
+  }
+
+  if(best_start == NULL)
+    best_len = 0;
+
+  *outlen = best_len;
+  return best_start;
+}
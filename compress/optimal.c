@@ -0,0 +1,215 @@
+#define COMPRESSION_INTERNAL
+#include "compress.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Minimum-size parse. Every match costs the same regardless of its
+// displacement, so only the longest match at each position matters: any
+// shorter length is available from the same source. Costs are in bits; a
+// token is its payload plus one flag bit.
+
+#define LITERAL_COST 9
+
+typedef struct
+{
+  size_t   min_len;
+  size_t   max_len;
+  uint32_t cost;
+} length_class_t;
+
+static const length_class_t lz10_classes[] =
+{
+  { 3,   LZ10_MAX_LEN, 17 },
+};
+
+static const length_class_t lz11_classes[] =
+{
+  { 3,   16,           17 },
+  { 17,  272,          25 },
+  { 273, LZ11_MAX_LEN, 33 },
+};
+
+// range-min over the suffix costs, which are filled in from the end
+typedef struct
+{
+  const uint32_t *cost;
+  uint32_t       *node; // index of the cheapest position below each node
+  size_t         size;
+} min_tree_t;
+
+static inline uint32_t
+min_tree_pick(const min_tree_t *tree, uint32_t a, uint32_t b)
+{
+  if(tree->cost[a] != tree->cost[b])
+    return tree->cost[a] < tree->cost[b] ? a : b;
+
+  // prefer the longer match on ties; it decodes faster
+  return a > b ? a : b;
+}
+
+static void
+min_tree_update(min_tree_t *tree, uint32_t pos)
+{
+  size_t i = pos + tree->size;
+
+  tree->node[i] = pos;
+  for(i >>= 1; i > 0; i >>= 1)
+    tree->node[i] = min_tree_pick(tree, tree->node[2*i], tree->node[2*i+1]);
+}
+
+static uint32_t
+min_tree_query(const min_tree_t *tree, size_t lo, size_t hi)
+{
+  uint32_t best = hi;
+
+  for(lo += tree->size, hi += tree->size + 1; lo < hi; lo >>= 1, hi >>= 1)
+  {
+    if(lo & 1)
+      best = min_tree_pick(tree, best, tree->node[lo++]);
+    if(hi & 1)
+      best = min_tree_pick(tree, best, tree->node[--hi]);
+  }
+
+  return best;
+}
+
+void*
+lzss_optimal_encode(const uint8_t        *start,
+                    const uint8_t        *buffer,
+                    size_t               len,
+                    size_t               *outlen,
+                    lzss_mode_t          mode,
+                    const lzss_options_t *opts,
+                    const lzss_sink_t    *sink)
+{
+  const size_t         max_len  = lzss_max_len(mode);
+  const size_t         max_disp = lzss_max_disp(mode);
+  const length_class_t *classes = mode == LZ11 ? lz11_classes : lz10_classes;
+  const size_t         nclasses = mode == LZ11
+                                ? sizeof(lz11_classes)/sizeof(lz11_classes[0])
+                                : sizeof(lz10_classes)/sizeof(lz10_classes[0]);
+
+  hash_chain_t  chain, *hc = NULL;
+  lzss_writer_t writer;
+  min_tree_t    tree;
+  uint32_t      *match_len  = NULL;
+  uint16_t      *match_disp = NULL;
+  uint32_t      *cost       = NULL;
+  const uint8_t *hint       = NULL;
+  size_t        hint_len    = 0;
+  void          *result     = NULL;
+  size_t        i;
+
+  if(len >= UINT32_MAX)
+    return NULL;
+
+  tree.node = NULL;
+  for(tree.size = 1; tree.size < len + 1; tree.size <<= 1)
+    ;
+
+  if(opts->matcher == LZSS_MATCHER_HASH || mode == BLZ)
+  {
+    if(hash_chain_init(&chain, start, buffer + len - start,
+                       lzss_min_disp(mode), max_disp) != 0)
+      return NULL;
+    hc = &chain;
+  }
+
+  match_len  = malloc(sizeof(*match_len)  * (len + 1));
+  match_disp = malloc(sizeof(*match_disp) * (len + 1));
+  cost       = malloc(sizeof(*cost)       * (len + 1));
+  tree.node  = malloc(sizeof(*tree.node)  * tree.size * 2);
+  if(!match_len || !match_disp || !cost || !tree.node)
+    goto out;
+
+  // longest match at every position
+  for(i = 0; i < len; ++i)
+  {
+    const uint8_t *src = NULL;
+    size_t        limit = len - i < max_len ? len - i : max_len;
+    size_t        mlen  = 0;
+
+    if(hc != NULL)
+      src = hash_chain_longest(hc, buffer + i, limit, hint, hint_len, &mlen);
+    else if(buffer + i > start)
+      src = find_best_match(start, buffer + i, limit, max_disp, &mlen);
+
+    if(src == NULL || mlen < 3)
+    {
+      match_len[i] = 0;
+      hint         = NULL;
+      hint_len     = 0;
+    }
+    else
+    {
+      match_len[i]  = mlen;
+      match_disp[i] = buffer + i - src;
+      hint          = src + 1;
+      hint_len      = mlen - 1;
+    }
+  }
+
+  // cheapest encoding of each suffix; match_len is reused for the choice
+  tree.cost = cost;
+  for(i = 0; i < tree.size * 2; ++i)
+    tree.node[i] = len;
+
+  cost[len] = 0;
+  min_tree_update(&tree, len);
+
+  for(i = len; i-- > 0; )
+  {
+    uint32_t best     = LITERAL_COST + cost[i+1];
+    uint32_t best_len = 1;
+    size_t   mlen     = match_len[i];
+    size_t   c;
+
+    for(c = 0; c < nclasses && mlen >= classes[c].min_len; ++c)
+    {
+      size_t   hi  = mlen < classes[c].max_len ? mlen : classes[c].max_len;
+      uint32_t pos = min_tree_query(&tree, i + classes[c].min_len, i + hi);
+
+      if(classes[c].cost + cost[pos] < best)
+      {
+        best     = classes[c].cost + cost[pos];
+        best_len = pos - i;
+      }
+    }
+
+    cost[i]      = best;
+    match_len[i] = best_len;
+    min_tree_update(&tree, i);
+  }
+
+  if(lzss_writer_init(&writer, mode, len, sink) != 0)
+    goto out;
+
+  for(i = 0; i < len; i += match_len[i])
+  {
+    int rc;
+
+    if(match_len[i] == 1)
+      rc = lzss_writer_literal(&writer, buffer[i]);
+    else
+      rc = lzss_writer_match(&writer, match_len[i], match_disp[i]);
+
+    if(rc != 0)
+    {
+      lzss_writer_destroy(&writer);
+      goto out;
+    }
+  }
+
+  result = lzss_writer_finish(&writer, outlen);
+
+out:
+  if(hc != NULL)
+    hash_chain_destroy(hc);
+  free(match_len);
+  free(match_disp);
+  free(cost);
+  free(tree.node);
+  return result;
+}
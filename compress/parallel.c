@@ -0,0 +1,219 @@
+#define COMPRESSION_INTERNAL
+#include "compress.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Blocks are compressed on their own and their tokens re-emitted into one
+// stream, since a block's token count rarely lines up with the flag bytes.
+
+typedef struct
+{
+  void   *data;
+  size_t len;
+} block_result_t;
+
+typedef struct
+{
+  const uint8_t        *buffer;
+  size_t               len;
+  lzss_mode_t          mode;
+  lzss_options_t       opts;
+  size_t               max_disp;
+
+  block_result_t       *blocks;
+  size_t               num_blocks;
+  size_t               next_block;
+  int                  failed;
+  pthread_mutex_t      lock;
+} parallel_job_t;
+
+static void*
+parallel_worker(void *arg)
+{
+  parallel_job_t *job = arg;
+
+  for(;;)
+  {
+    size_t        block;
+    const uint8_t *start, *buffer;
+    size_t        len;
+
+    pthread_mutex_lock(&job->lock);
+    block = job->next_block++;
+    if(job->failed)
+      block = job->num_blocks;
+    pthread_mutex_unlock(&job->lock);
+
+    if(block >= job->num_blocks)
+      break;
+
+    buffer = job->buffer + block * job->opts.block_size;
+    len    = job->len - block * job->opts.block_size;
+    if(len > job->opts.block_size)
+      len = job->opts.block_size;
+
+    start = buffer;
+    if(job->opts.prime)
+      start = (size_t)(buffer - job->buffer) < job->max_disp ? job->buffer
+                                                   : buffer - job->max_disp;
+
+    job->blocks[block].data = lzss_range_encode(start, buffer, len,
+                                                &job->blocks[block].len,
+                                                job->mode, &job->opts, NULL);
+    if(job->blocks[block].data == NULL)
+    {
+      pthread_mutex_lock(&job->lock);
+      job->failed = 1;
+      pthread_mutex_unlock(&job->lock);
+    }
+  }
+
+  return NULL;
+}
+
+static int
+append_block(lzss_writer_t *writer, const uint8_t *src, size_t size)
+{
+  int     i;
+  uint8_t flags;
+  size_t  header_size;
+
+  // skip the block's own header, which must be for the block's size
+  src += compression_size(src, &header_size);
+  if(header_size != size)
+    return -1;
+
+  while(size > 0)
+  {
+    flags = *src++;
+    for(i = 0; i < 8 && size > 0; i++, flags <<= 1)
+    {
+      int rc;
+
+      if(flags & 0x80)
+      {
+        size_t len, disp;
+
+        if(writer->mode == LZ10)
+          len = ((*src)>>4) + 3;
+        else switch((*src)>>4)
+        {
+          case 0:
+            len   = (*src++)<<4;
+            len  |= ((*src)>>4);
+            len  += 0x11;
+            break;
+          case 1:
+            len   = ((*src++)&0x0F)<<12;
+            len  |= (*src++)<<4;
+            len  |= ((*src)>>4);
+            len  += 0x111;
+            break;
+          default:
+            len   = ((*src)>>4)+1;
+            break;
+        }
+
+        disp  = ((*src++)&0x0F)<<8;
+        disp |= *src++;
+
+        assert(len <= size);
+        size -= len;
+
+        rc = lzss_writer_match(writer, len, disp + 1);
+      }
+      else
+      {
+        rc = lzss_writer_literal(writer, *src++);
+        --size;
+      }
+
+      if(rc != 0)
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+void*
+lzss_parallel_encode(const uint8_t        *buffer,
+                     size_t               len,
+                     size_t               *outlen,
+                     lzss_mode_t          mode,
+                     const lzss_options_t *opts,
+                     const lzss_sink_t    *sink)
+{
+  parallel_job_t job;
+  lzss_writer_t  writer;
+  pthread_t      *threads;
+  unsigned       num_threads = opts->threads, i;
+  void           *result = NULL;
+
+  assert(opts->block_size > 0);
+
+  job.buffer     = buffer;
+  job.len        = len;
+  job.mode       = mode;
+  job.opts       = *opts;
+  job.max_disp   = lzss_max_disp(mode);
+  job.num_blocks = (len + opts->block_size - 1) / opts->block_size;
+  job.next_block = 0;
+  job.failed     = 0;
+
+  if(num_threads > job.num_blocks)
+    num_threads = job.num_blocks;
+
+  job.blocks = calloc(job.num_blocks, sizeof(*job.blocks));
+  threads    = calloc(num_threads, sizeof(*threads));
+  if(!job.blocks || !threads || pthread_mutex_init(&job.lock, NULL) != 0)
+  {
+    free(job.blocks);
+    free(threads);
+    return NULL;
+  }
+
+  // the calling thread is one of the workers
+  for(i = 1; i < num_threads; ++i)
+  {
+    if(pthread_create(&threads[i], NULL, parallel_worker, &job) != 0)
+      break;
+  }
+  num_threads = i;
+
+  parallel_worker(&job);
+
+  for(i = 1; i < num_threads; ++i)
+    pthread_join(threads[i], NULL);
+
+  if(!job.failed && lzss_writer_init(&writer, mode, len, sink) == 0)
+  {
+    size_t block;
+
+    for(block = 0; block < job.num_blocks; ++block)
+    {
+      size_t block_len = len - block * opts->block_size;
+      if(block_len > opts->block_size)
+        block_len = opts->block_size;
+
+      if(append_block(&writer, job.blocks[block].data, block_len) != 0)
+        break;
+    }
+
+    if(block == job.num_blocks)
+      result = lzss_writer_finish(&writer, outlen);
+    else
+      lzss_writer_destroy(&writer);
+  }
+
+  for(i = 0; i < job.num_blocks; ++i)
+    free(job.blocks[i].data);
+
+  pthread_mutex_destroy(&job.lock);
+  free(job.blocks);
+  free(threads);
+  return result;
+}
@@ -0,0 +1,88 @@
+#define COMPRESSION_INTERNAL
+#include "compress.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Run-length encoding, type 0x30.
+//
+// After the header, a flag byte either says that the next (flag & 0x7F) + 3
+// bytes all equal the single byte that follows (bit 7 set), or that the
+// (flag & 0x7F) + 1 bytes that follow are stored as is.
+
+#define RLE_MAX_RUN     130
+#define RLE_MAX_LITERAL 128
+
+static int
+rle_literals(buffer_t *result, const uint8_t *data, size_t len)
+{
+  while(len > 0)
+  {
+    size_t  n    = len < RLE_MAX_LITERAL ? len : RLE_MAX_LITERAL;
+    uint8_t flag = n - 1;
+
+    if(buffer_push(result, &flag, 1) != 0
+    || buffer_push(result, data, n) != 0)
+      return -1;
+
+    data += n;
+    len  -= n;
+  }
+
+  return 0;
+}
+
+void*
+rle_encode(const void *src,
+           size_t     len,
+           size_t     *outlen)
+{
+  const uint8_t *input = (const uint8_t*)src;
+  buffer_t      result;
+  uint8_t       header[8], token[2];
+  size_t        i = 0, start = 0, header_len;
+
+  if(len > UINT32_MAX)
+    return NULL;
+
+  buffer_init(&result);
+  header_len = compression_header(header, 0x30, len);
+  if(buffer_push(&result, header, header_len) != 0)
+    goto error;
+
+  while(i < len)
+  {
+    size_t run = 1;
+
+    while(i + run < len && run < RLE_MAX_RUN && input[i + run] == input[i])
+      ++run;
+
+    if(run < 3)
+    {
+      i += run;
+      continue;
+    }
+
+    if(rle_literals(&result, input + start, i - start) != 0)
+      goto error;
+
+    token[0] = 0x80 | (run - 3);
+    token[1] = input[i];
+    if(buffer_push(&result, token, sizeof(token)) != 0)
+      goto error;
+
+    i    += run;
+    start = i;
+  }
+
+  if(rle_literals(&result, input + start, len - start) != 0
+  || buffer_pad(&result, 4) != 0)
+    goto error;
+
+  *outlen = result.len;
+  return result.data;
+
+error:
+  buffer_destroy(&result);
+  return NULL;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Run-length decoder for the 0x30 format. Header-only and free of libc
+// calls so that the payloads can include it directly; see rle.c for the
+// format. Same interface as lzss_decode: src points past the header
+// and size is the decoded size.
+
+#include <stdint.h>
+
+static inline void
+rle_decode(const uint8_t *src, uint8_t *dst, uint32_t size)
+{
+  uint8_t *end = dst + size;
+
+  while(dst < end)
+  {
+    uint8_t  flag = *src++;
+    uint32_t len;
+
+    if(flag & 0x80)
+    {
+      uint8_t v = *src++;
+
+      len = (flag & 0x7F) + 3;
+      if(len > (uint32_t)(end - dst))
+        len = end - dst;
+
+      while(len-- > 0)
+        *dst++ = v;
+    }
+    else
+    {
+      len = (flag & 0x7F) + 1;
+      if(len > (uint32_t)(end - dst))
+        len = end - dst;
+
+      while(len-- > 0)
+        *dst++ = *src++;
+    }
+  }
+}
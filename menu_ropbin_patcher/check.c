@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef unsigned char u8;
+typedef unsigned int u32;
+
+// patchPayload with the old search for its aliases next to the one which
+// walks the ropbin's table, on the same ropbins, for every target process
+
+#define FIRM_APPMEMALLOC 0x06000000
+#define IS_N3DS 1
+// whatever the region's are, as long as they differ between targets
+#define CAMAPP_TIDLOW 0x00020200
+#define DLPLAY_TIDLOW 0x00021500
+#define ACTAPP_TIDLOW 0x00021800
+#define MSET_TIDLOW 0x00022200
+#define NFACE_TIDLOW 0x00022400
+
+#include "../app_targets/app_targets.h"
+
+// patchPayload before the table, which looked at every word
+static void patchPayloadScan(u32* payload_dst, int targetProcessIndex, memorymap_t* mmap)
+{
+	if(!mmap) mmap = (memorymap_t*)app_maps[targetProcessIndex];
+	int i;
+	for(i = 0; i < 0x10000 / 4; i++)
+	{
+		u32 val = payload_dst[i];
+		if(val >> 16 == 0xBABE)
+		{
+			val &= 0xFFFF;
+			if(val == 0x0001) payload_dst[i] = targetProcessIndex;
+			else if(val == 0x0002) payload_dst[i] = 0x30000000 + FIRM_APPMEMALLOC - mmap->header.processLinearOffset;
+			else if(val == 0x0003) payload_dst[i] = mmap->header.processHookAddress;
+			else if(val == 0x0004)
+			{
+				if(mmap->header.mediatype == 2) payload_dst[i] = 0;
+				else payload_dst[i] = mmap->header.processHookTidLow;
+			}
+			else if(val == 0x0005)
+			{
+				if(mmap->header.mediatype == 2) payload_dst[i] = 0;
+				else payload_dst[i] = mmap->header.processHookTidHigh;
+			}
+			else if(val == 0x0006) memcpy(&payload_dst[i], mmap, sizeof(memorymap_header_t) + sizeof(memorymap_entry_t) * mmap->header.num);
+			else if(val == 0x0007) payload_dst[i] = mmap->header.processAppCodeAddress;
+			else if(val == 0x0008) payload_dst[i] = mmap->header.processHookTidLow & ~0x20000000;
+			else if(val == 0x0009) payload_dst[i] = mmap->header.processHookTidHigh;
+			else if(val == 0x000A) payload_dst[i] = mmap->header.mediatype;
+		}
+	}
+}
+
+static u32 seed = 0x3D5;
+
+static u32 nextRandom()
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) | (seed << 16);
+}
+
+// the two assemblies of a ropbin as menu_payload/Makefile makes them, for
+// scripts/ropRelocs.py to append the table to the first of: random words,
+// with aliases made of ROP_ALIAS_BASE and some which are the same in both,
+// as app_bootloader's are
+static bool generate(const char* fnA, const char* fnB)
+{
+	static u32 a[0x6000 / 4], b[0x6000 / 4];
+	const u32 num = sizeof(a) / sizeof(a[0]);
+	u32 i;
+	for(i = 0; i < num; i++)
+	{
+		u32 r = nextRandom();
+		if(r % 24)
+		{
+			do r = nextRandom(); while(r >> 16 == 0xBABE || r >> 16 == 0xC0DE);
+			a[i] = b[i] = r;
+			continue;
+		}
+		u32 kind = 1 + (r >> 8) % 10;
+		// a memorymap needs room for itself
+		if(kind == 0x6 && i + 0x40 > num) kind = 0x1;
+		a[i] = 0xBABE0000 + kind;
+		b[i] = (r & 0x10) ? a[i] : 0xC0DE0000 + kind;
+		if(kind == 0x6)
+		{
+			for(r = 1; r < 0x40; r++) a[i + r] = b[i + r] = 0;
+			i += 0x3F;
+		}
+	}
+
+	FILE* f = fopen(fnA, "wb");
+	if(!f) return false;
+	fwrite(a, 1, sizeof(a), f);
+	fclose(f);
+	f = fopen(fnB, "wb");
+	if(!f) return false;
+	fwrite(b, 1, sizeof(b), f);
+	fclose(f);
+	return true;
+}
+
+// both on copies of ropbin, as main.c lays them out, -1 for no table
+static int check(const u8* ropbin, int processIndex, memorymap_t* mmap)
+{
+	static u32 scanned[0x10000 / 4], walked[0x10000 / 4];
+
+	memset(scanned, 0x00, sizeof(scanned));
+	memcpy(scanned, ropbin, ROPBIN_SIZE);
+	memcpy(walked, scanned, sizeof(walked));
+
+	patchPayloadScan(scanned, processIndex, mmap);
+	if(patchPayload(walked, processIndex, mmap)) return -1;
+
+	u32 i;
+	for(i = 0; i < sizeof(scanned) / sizeof(scanned[0]); i++)
+	{
+		if(scanned[i] != walked[i])
+		{
+			printf("process %d : 0x%08X instead of 0x%08X at 0x%X\n", processIndex, walked[i], scanned[i], i * 4);
+			return -2;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc == 4 && !strcmp(argv[1], "gen")) return generate(argv[2], argv[3]) ? 0 : -3;
+	if(argc < 2)
+	{
+		printf("use : %s gen <a.bin> <b.bin>\n", argv[0]);
+		printf("      %s <menu_ropbin.bin> ...\n", argv[0]);
+		return -1;
+	}
+
+	static u8 ropbin[ROPBIN_SIZE];
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		FILE* f = fopen(argv[i], "rb");
+		if(!f || fread(ropbin, 1, ROPBIN_SIZE, f) != ROPBIN_SIZE)
+		{
+			printf("%s is no ropbin\n", argv[i]);
+			return -3;
+		}
+		fclose(f);
+
+		int j;
+		for(j = -1; j < numTargetProcesses; j++)
+		{
+			// -1 stands for a memorymap file, -2 in targets.c
+			int ret = check(ropbin, j < 0 ? -2 : j, (memorymap_t*)app_maps[j < 0 ? 0 : j]);
+			if(ret == -1) printf("%s has no table\n", argv[i]);
+			if(ret) return -4;
+		}
+		printf("%s : same for all %d targets\n", argv[i], numTargetProcesses + 1);
+	}
+
+	return 0;
+}
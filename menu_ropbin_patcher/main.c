@@ -6,41 +6,195 @@
 typedef unsigned char u8;
 typedef unsigned int u32;
 
-#include "../build/constants.h"
-#include "../app_targets/app_targets.h"
+#include "targets.h"
 
-int main(int argc, char** argv)
-{
-	if(argc < 3) return -1;
+// what a target's version needs from build/constants.db, see
+// scripts/constantsDb.py for its layout
+static u8* db;
 
-	FILE* f = fopen(argv[1], "rb");
-	if(!f) return -2;
+static const char* tidLowNames[] = {"CAMAPP_TIDLOW", "DLPLAY_TIDLOW", "ACTAPP_TIDLOW", "MSET_TIDLOW", "NFACE_TIDLOW"};
+
+static u8* readFile(const char* fn, int* size)
+{
+	FILE* f = fopen(fn, "rb");
+	if(!f) return NULL;
 
 	fseek(f, 0, SEEK_END);
-	int size = ftell(f);
+	*size = ftell(f);
 	fseek(f, 0, SEEK_SET);
 
-	u8* file_buffer = malloc(size);
-	fread(file_buffer, 1, size, f);
+	u8* buffer = malloc(*size);
+	fread(buffer, 1, *size, f);
 
 	fclose(f);
-	f = NULL;
+
+	return buffer;
+}
+
+static u32 dbWord(u32 offset)
+{
+	return *(u32*)&db[offset];
+}
+
+// orders like python's bytes, as the tables are sorted
+static int dbCompare(u32 offset, u32 length, const char* s)
+{
+	u32 l = strlen(s);
+	int r = memcmp(&db[dbWord(24) + offset], s, length < l ? length : l);
+	if(r) return r;
+	return (length > l) - (length < l);
+}
+
+static u32* dbEntry(u32* section, u32 i)
+{
+	return (u32*)&db[dbWord(16) + dbWord(dbWord(20) + (section[2] + i) * 4) * 16];
+}
+
+static const char* dbLookup(const char* name, const char* key)
+{
+	u32* section = NULL;
+	u32 lo = 0, hi = dbWord(4);
+	while(lo < hi)
+	{
+		u32 mid = (lo + hi) / 2;
+		u32* s = (u32*)&db[dbWord(8) + mid * 16];
+		int r = dbCompare(s[0], s[1], name);
+		if(!r)
+		{
+			section = s;
+			break;
+		}
+		if(r < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	if(!section) return NULL;
+
+	// the last of the entries named key
+	lo = 0;
+	hi = section[3];
+	while(lo < hi)
+	{
+		u32 mid = (lo + hi) / 2;
+		u32* e = dbEntry(section, mid);
+		if(dbCompare(e[0], e[1], key) <= 0) lo = mid + 1;
+		else hi = mid;
+	}
+	if(!lo) return NULL;
+	u32* e = dbEntry(section, lo - 1);
+	if(dbCompare(e[0], e[1], key)) return NULL;
+	return (const char*)&db[dbWord(24) + e[2]];
+}
+
+static bool dbValue(const char* section, const char* key, u32* out)
+{
+	const char* value = dbLookup(section, key);
+	if(!value)
+	{
+		printf("no %s in %s\n", key, section);
+		return false;
+	}
+	char* end;
+	*out = strtoul(value, &end, 0);
+	if(!*value || *end)
+	{
+		printf("%s in %s is not a number : %s\n", key, section, value);
+		return false;
+	}
+	return true;
+}
+
+// version is <firmver>_<region>_<msetver>, what is a process index or a memorymap file
+static bool parseTarget(const char* version, const char* what, target_t* target, bool* mset8203)
+{
+	char firm[32], region[32], section[64];
+	u32 mset;
+	if(sscanf(version, "%31[^_]_%31[^_]_%u", firm, region, &mset) != 3)
+	{
+		printf("bad version : %s\n", version);
+		return false;
+	}
+	*mset8203 = mset == 8203;
+	target->isN3ds = !strncmp(firm, "N3DS", 4);
+
+	sprintf(section, "firm/%s", firm);
+	if(!dbValue(section, "FIRM_APPMEMALLOC", &target->appMemAlloc)) return false;
+
+	char* end;
+	target->processIndex = strtol(what, &end, 0);
+	if(*what && !*end)
+	{
+		if(target->processIndex < 0 || target->processIndex >= (int)(sizeof(tidLowNames) / sizeof(tidLowNames[0])))
+		{
+			printf("bad process index : %s\n", what);
+			return false;
+		}
+		target->mmap = NULL;
+		sprintf(section, "region/%s", region);
+		return dbValue(section, tidLowNames[target->processIndex], &target->tidLow);
+	}
+
+	int size;
+	target->processIndex = -2;
+	target->mmap = readFile(what, &size);
+	target->mmapSize = size;
+	if(!target->mmap)
+	{
+		printf("can't open %s\n", what);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 6 || (argc - 3) % 3)
+	{
+		printf("use : %s <constants.db> <menu_ropbin.bin> (<out.bin> <firmver>_<region>_<msetver> (<process index> | <memorymap.bin>)) ...\n", argv[0]);
+		return -1;
+	}
+
+	int size;
+	db = readFile(argv[1], &size);
+	if(!db || size < 32 || memcmp(db, "CDB1", 4)) return -2;
+
+	u8* file_buffer = readFile(argv[2], &size);
+	if(!file_buffer || size > 0x8000) return -2;
 
 	u8* final_buffer = malloc(0x10000);
-	memset(final_buffer, 0x00, 0x10000);
 
-	memcpy(final_buffer, file_buffer, size);
+	int i;
+	for(i = 3; i < argc; i += 3)
+	{
+		target_t target;
+		bool mset8203;
+		if(!parseTarget(argv[i + 1], argv[i + 2], &target, &mset8203)) return -5;
 
-	patchPayload((u32*)final_buffer, 1, NULL);
+		memset(final_buffer, 0x00, 0x10000);
 
-	memcpy(&final_buffer[0x8000], file_buffer, size);
+		memcpy(final_buffer, file_buffer, size);
 
-	f = fopen(argv[2], "wb");
-	if(!f) return -3;
+		int ret = mset8203 ? patchTarget8203((u32*)final_buffer, &target) : patchTarget((u32*)final_buffer, &target);
+		if(ret == -2)
+		{
+			printf("%s has no process %d\n", argv[i + 1], target.processIndex);
+			return -5;
+		}
+		if(ret == -3)
+		{
+			printf("%s is not a memorymap\n", argv[i + 2]);
+			return -5;
+		}
+		if(ret) return -4;
 
-	fwrite(final_buffer, 1, 0x10000, f);
+		memcpy(&final_buffer[0x8000], file_buffer, size);
 
-	fclose(f);
+		FILE* f = fopen(argv[i], "wb");
+		if(!f) return -3;
+
+		fwrite(final_buffer, 1, 0x10000, f);
+
+		fclose(f);
+	}
 
 	return 0;
 }
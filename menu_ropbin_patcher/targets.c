@@ -0,0 +1,41 @@
+#include <stdbool.h>
+#include <string.h>
+
+typedef unsigned char u8;
+typedef unsigned int u32;
+
+// the constants app_targets.h would get from constants.h come from the target
+// instead, so that the patcher is the same for every version
+static u32 firmAppMemAlloc;
+
+#define FIRM_APPMEMALLOC firmAppMemAlloc
+#define IS_N3DS 1
+#define CAMAPP_TIDLOW 0
+#define DLPLAY_TIDLOW 0
+#define ACTAPP_TIDLOW 0
+#define MSET_TIDLOW 0
+#define NFACE_TIDLOW 0
+
+#include "../app_targets/app_targets.h"
+#include "targets.h"
+
+int PATCH_TARGET(u32* payload, const target_t* target)
+{
+	firmAppMemAlloc = target->appMemAlloc;
+
+	if(target->processIndex == -2)
+	{
+		const memorymap_t* mmap = target->mmap;
+		if(target->mmapSize < sizeof(memorymap_header_t) || target->mmapSize < size_memmap(*mmap)) return -3;
+		return patchPayload(payload, -2, (memorymap_t*)mmap);
+	}
+	// IS_N3DS is 1 here, the last target is only there on N3DS
+	if(target->processIndex < 0 || target->processIndex >= numTargetProcesses - !target->isN3ds) return -2;
+
+	u32 buffer[0x80];
+	const memorymap_t* mmap = app_maps[target->processIndex];
+	memcpy(buffer, mmap, size_memmap(*mmap));
+	((memorymap_t*)buffer)->header.processHookTidLow = target->tidLow;
+
+	return patchPayload(payload, target->processIndex, (memorymap_t*)buffer);
+}
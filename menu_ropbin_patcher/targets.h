@@ -0,0 +1,14 @@
+// what a patched ropbin is for
+typedef struct
+{
+	u32 appMemAlloc; // FIRM_APPMEMALLOC
+	bool isN3ds;
+	int processIndex; // into app_maps, or -2 for mmap
+	u32 tidLow; // the region's TID low for processIndex
+	const void* mmap; // a memorymap_t, for processIndex -2
+	u32 mmapSize;
+} target_t;
+
+// targets.c, built with and without MSET_VERSION 8203 as msetapp_map depends on it
+int patchTarget(u32* payload, const target_t* target);
+int patchTarget8203(u32* payload, const target_t* target);
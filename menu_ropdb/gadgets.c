@@ -0,0 +1,1268 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Finds ROP gadgets in a home menu code.bin, for versions where the words
+// around a proto gadget changed and port.exe cannot find it again.
+//
+// Every aligned word is decoded as an ARM instruction. Each return
+//   pop {..., pc}                  (also ldr pc, [sp], #4)
+//   bx rN / blx rN
+//   ldm rN, {..., sp, ..., pc}     a stack pivot, which may be conditional
+// starts a gadget, as does each run of up to --max-body instructions right
+// before it that neither branch nor write pc (nor sp, other than by popping,
+// pushing or adding to it). The gadgets are indexed by what they run before
+// their return, and each one costs the words it takes off the stack.
+//
+// A spec is the instructions of a gadget as objdump prints them, separated
+// by ';'. Register aliases, the base of numbers and '#' do not matter. The
+// gadget has to run exactly the instructions of the spec, and then return
+// as its last one says:
+//   pop {regs}   a pop of at least regs and pc; the others are dummy words
+//   bx rN, ...   exactly that return
+//   pivot rN     any pivot off rN
+// or, when the last one is none of those, with any pop {..., pc}. Of the
+// gadgets that fit, the one that costs the fewest words wins, then an
+// unconditional one, then the lowest address.
+
+#define DEFAULT_MAX_BODY 5
+#define TEXT_SIZE        96
+
+#define COND_AL 14
+
+#define REG_SP 13
+#define REG_LR 14
+#define REG_PC 15
+
+enum
+{
+  INSN_BODY,
+  INSN_POP,
+  INSN_BX,
+  INSN_PIVOT,
+};
+
+typedef struct
+{
+  int      kind;
+  int      cond;
+  int      stack; // words taken off the stack, or put on it if negative
+  uint16_t regs;  // pop and pivot: the registers loaded
+  int      base;  // pivot: the base register
+  char     text[TEXT_SIZE];
+} insn_t;
+
+typedef struct
+{
+  uint32_t addr;
+  uint32_t ret;  // address of the return
+  int      cost;
+  int      conditional;
+  int      kind;
+  uint16_t regs;
+  int      base;
+  char     *body; // normalized, instructions joined by ';'
+  char     *ret_text;
+} gadget_t;
+
+static const char *reg_names[16] =
+{
+  "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+  "r8", "r9", "sl", "fp", "ip", "sp", "lr", "pc",
+};
+
+static const char *cond_names[15] =
+{
+  "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
+  "hi", "ls", "ge", "lt", "gt", "le", "",
+};
+
+static const char *dp_names[16] =
+{
+  "and", "eor", "sub", "rsb", "add", "adc", "sbc", "rsc",
+  "tst", "teq", "cmp", "cmn", "orr", "mov", "bic", "mvn",
+};
+
+static const char *shift_names[4] = { "lsl", "lsr", "asr", "ror" };
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options] code.bin base [[NAME=]spec ...]\n"
+          "  --max-body=N  up to N instructions before the return "
+          "(default: %d)\n"
+          "Without specs, every distinct gadget is listed. Named specs are\n"
+          "printed as a ropDB.\n",
+          prog, DEFAULT_MAX_BODY);
+}
+
+static uint32_t
+get32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int
+read_file(const char *name, uint8_t **data, size_t *len)
+{
+  FILE   *file = fopen(name, "rb");
+  size_t limit = 0, rc;
+
+  *data = NULL;
+  *len  = 0;
+
+  if(!file)
+    return -1;
+
+  do
+  {
+    if(*len == limit)
+    {
+      uint8_t *grown;
+
+      limit = limit ? limit * 2 : 0x100000;
+      grown = realloc(*data, limit);
+      if(!grown)
+      {
+        errno = ENOMEM;
+        break;
+      }
+      *data = grown;
+    }
+
+    rc    = fread(*data + *len, 1, limit - *len, file);
+    *len += rc;
+  } while(rc > 0);
+
+  if(ferror(file) || !feof(file))
+  {
+    int err = errno;
+
+    fclose(file);
+    free(*data);
+    errno = err;
+    return -1;
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static int
+popcount(uint16_t regs)
+{
+  int n = 0;
+
+  for(; regs; regs &= regs - 1)
+    ++n;
+
+  return n;
+}
+
+static void
+format_imm(char *out, uint32_t value, int negative)
+{
+  if(value < 10)
+    sprintf(out, "#%s%u", negative ? "-" : "", value);
+  else
+    sprintf(out, "#%s0x%x", negative ? "-" : "", value);
+}
+
+static void
+format_regs(char *out, uint16_t regs)
+{
+  int i, first = 1;
+
+  out += sprintf(out, "{");
+  for(i = 0; i < 16; ++i)
+  {
+    if(regs & (1 << i))
+    {
+      out  += sprintf(out, "%s%s", first ? "" : ", ", reg_names[i]);
+      first = 0;
+    }
+  }
+  sprintf(out, "}");
+}
+
+// ", lsl #n" and the like for an immediate-shifted register operand
+static void
+format_shift(char *out, uint32_t w)
+{
+  int type = (w >> 5) & 3, amount = (w >> 7) & 0x1F;
+
+  *out = 0;
+  if(type == 0 && amount == 0)
+    return;
+  if(type == 3 && amount == 0)
+    sprintf(out, ", rrx");
+  else
+    sprintf(out, ", %s #%d", shift_names[type], amount ? amount : 32);
+}
+
+static int
+decode_data(uint32_t w, insn_t *insn, const char *cond)
+{
+  int  op = (w >> 21) & 0xF, s = (w >> 20) & 1;
+  int  rn = (w >> 16) & 0xF, rd = (w >> 12) & 0xF, rm = w & 0xF;
+  int  writes = op < 8 || op > 11;
+  char operand[48], shift[16];
+
+  // tst to cmn without the S bit are other instructions
+  if(!writes && !s)
+    return -1;
+
+  if(writes && (rd == REG_PC || (rd == REG_SP && !(w & (1 << 25)))))
+    return -1;
+
+  // fields that should be zero
+  if((!writes && rd != 0) || ((op == 13 || op == 15) && rn != 0))
+    return -1;
+
+  if(w & (1 << 25))
+  {
+    int      rotate = ((w >> 8) & 0xF) * 2;
+    uint32_t imm    = w & 0xFF;
+
+    imm = rotate ? (imm >> rotate) | (imm << (32 - rotate)) : imm;
+    format_imm(operand, imm, 0);
+
+    if(writes && rd == REG_SP)
+    {
+      // only moving sp along the stack
+      if(rn != REG_SP || (op != 2 && op != 4) || s)
+        return -1;
+      insn->stack = (op == 4 ? 1 : -1) * (int)(imm / 4);
+    }
+  }
+  else
+  {
+    if(w & (1 << 4))
+    {
+      int rs = (w >> 8) & 0xF;
+
+      if(rs == REG_PC || rm == REG_PC || rn == REG_PC)
+        return -1;
+
+      if(op == 13)
+      {
+        sprintf(insn->text, "%s%s%s %s, %s, %s",
+                shift_names[(w >> 5) & 3], s ? "s" : "", cond,
+                reg_names[rd], reg_names[rm], reg_names[rs]);
+        return 0;
+      }
+
+      sprintf(operand, "%s, %s %s", reg_names[rm],
+              shift_names[(w >> 5) & 3], reg_names[rs]);
+    }
+    else if(op == 13 && ((w >> 4) & 0xFF) != 0)
+    {
+      // mov with a shift is written as the shift
+      int type = (w >> 5) & 3, amount = (w >> 7) & 0x1F;
+
+      if(type == 3 && amount == 0)
+        sprintf(insn->text, "rrx%s%s %s, %s", s ? "s" : "", cond,
+                reg_names[rd], reg_names[rm]);
+      else
+        sprintf(insn->text, "%s%s%s %s, %s, #%d", shift_names[type],
+                s ? "s" : "", cond, reg_names[rd], reg_names[rm],
+                amount ? amount : 32);
+      return 0;
+    }
+    else
+    {
+      format_shift(shift, w);
+      sprintf(operand, "%s%s", reg_names[rm], shift);
+    }
+  }
+
+  if(!writes)
+  {
+    sprintf(insn->text, "%s%s %s, %s", dp_names[op], cond, reg_names[rn],
+            operand);
+    return 0;
+  }
+
+  if(op == 13 || op == 15)
+    sprintf(insn->text, "%s%s%s %s, %s", dp_names[op], s ? "s" : "", cond,
+            reg_names[rd], operand);
+  else
+    sprintf(insn->text, "%s%s%s %s, %s, %s", dp_names[op], s ? "s" : "",
+            cond, reg_names[rd], reg_names[rn], operand);
+  return 0;
+}
+
+// "[rn, #imm]", "[rn, #imm]!" or "[rn], #imm" and the like
+static void
+format_address(char *out, uint32_t w, const char *offset, int zero)
+{
+  int p = (w >> 24) & 1, wb = (w >> 21) & 1, rn = (w >> 16) & 0xF;
+
+  if(!p)
+    sprintf(out, "[%s], %s", reg_names[rn], offset);
+  else if(zero && !wb)
+    sprintf(out, "[%s]", reg_names[rn]);
+  else
+    sprintf(out, "[%s, %s]%s", reg_names[rn], offset, wb ? "!" : "");
+}
+
+// the words that writing back moves sp by, for loads and stores off sp with
+// an immediate offset
+static void
+address_stack(uint32_t w, uint32_t imm, insn_t *insn)
+{
+  int p = (w >> 24) & 1, u = (w >> 23) & 1, wb = (w >> 21) & 1;
+
+  if(((w >> 16) & 0xF) == REG_SP && (!p || wb))
+    insn->stack = (u ? 1 : -1) * (int)(imm / 4);
+}
+
+static int
+decode_transfer(uint32_t w, insn_t *insn, const char *cond)
+{
+  int      p = (w >> 24) & 1, u = (w >> 23) & 1, b = (w >> 22) & 1;
+  int      wb = (w >> 21) & 1, l = (w >> 20) & 1;
+  int      rn = (w >> 16) & 0xF, rd = (w >> 12) & 0xF;
+  uint32_t imm = w & 0xFFF;
+  char     offset[48], shift[16], address[64];
+
+  // ldrt and the like
+  if(!p && wb)
+    return -1;
+
+  if(w & (1 << 25))
+  {
+    if(w & (1 << 4))
+      return -1;
+
+    format_shift(shift, w);
+    sprintf(offset, "%s%s%s", u ? "" : "-", reg_names[w & 0xF], shift);
+    if(rn == REG_SP && (wb || !p))
+      return -1;
+    format_address(address, w, offset, 0);
+  }
+  else
+  {
+    format_imm(offset, imm, !u);
+    address_stack(w, imm, insn);
+    format_address(address, w, offset, imm == 0);
+  }
+
+  if(rd == REG_PC)
+  {
+    // pop {pc}
+    if(w == 0xE49DF004)
+    {
+      insn->kind  = INSN_POP;
+      insn->regs  = 1 << REG_PC;
+      insn->stack = 1;
+      strcpy(insn->text, "pop {pc}");
+      return 0;
+    }
+    return -1;
+  }
+
+  if(l && rd == REG_SP)
+    return -1;
+
+  if(!b && !(w & (1 << 25)) && rn == REG_SP && l && !p && u && imm == 4)
+    sprintf(insn->text, "pop%s {%s}", cond, reg_names[rd]);
+  else if(!b && !(w & (1 << 25)) && rn == REG_SP && !l && p && !u && wb
+       && imm == 4)
+    sprintf(insn->text, "push%s {%s}", cond, reg_names[rd]);
+  else
+    sprintf(insn->text, "%s%s%s %s, %s", l ? "ldr" : "str", b ? "b" : "",
+            cond, reg_names[rd], address);
+  return 0;
+}
+
+// ldrh, strh, ldrsb, ldrsh, ldrd and strd
+static int
+decode_extra(uint32_t w, insn_t *insn, const char *cond)
+{
+  static const char *names[2][4] =
+  {
+    { NULL, "strh", "ldrd", "strd" },
+    { NULL, "ldrh", "ldrsb", "ldrsh" },
+  };
+  int        p = (w >> 24) & 1, u = (w >> 23) & 1, wb = (w >> 21) & 1;
+  int        l = (w >> 20) & 1, rn = (w >> 16) & 0xF, rd = (w >> 12) & 0xF;
+  int        op = (w >> 5) & 3;
+  uint32_t   imm = ((w >> 4) & 0xF0) | (w & 0xF);
+  const char *name = names[l][op];
+  char       offset[48], address[64];
+
+  if(!p && wb)
+    return -1;
+
+  if(w & (1 << 22))
+  {
+    format_imm(offset, imm, !u);
+    address_stack(w, imm, insn);
+    format_address(address, w, offset, imm == 0);
+  }
+  else
+  {
+    if(rn == REG_SP && (wb || !p))
+      return -1;
+    sprintf(offset, "%s%s", u ? "" : "-", reg_names[w & 0xF]);
+    format_address(address, w, offset, 0);
+  }
+
+  if(op >= 2 && !l)
+  {
+    if(rd & 1 || rd >= REG_LR - 1)
+      return -1;
+    if(op == 2 && rd + 1 == REG_SP)
+      return -1;
+    sprintf(insn->text, "%s%s %s, %s, %s", name, cond, reg_names[rd],
+            reg_names[rd + 1], address);
+    return 0;
+  }
+
+  if(rd == REG_PC || (l && rd == REG_SP))
+    return -1;
+
+  sprintf(insn->text, "%s%s %s, %s", name, cond, reg_names[rd], address);
+  return 0;
+}
+
+static int
+decode_block(uint32_t w, insn_t *insn, const char *cond)
+{
+  static const char *modes[4] = { "da", "", "db", "ib" };
+  int      pu = (w >> 23) & 3, wb = (w >> 21) & 1, l = (w >> 20) & 1;
+  int      rn = (w >> 16) & 0xF;
+  uint16_t regs = w & 0xFFFF;
+  char     list[80];
+
+  if((w & (1 << 22)) || regs == 0 || rn == REG_PC)
+    return -1;
+
+  format_regs(list, regs);
+
+  if(l && (regs & (1 << REG_PC)))
+  {
+    if(rn == REG_SP && pu == 1 && wb && !(regs & (1 << REG_SP))
+    && insn->cond == COND_AL)
+    {
+      insn->kind  = INSN_POP;
+      insn->regs  = regs;
+      insn->stack = popcount(regs);
+      sprintf(insn->text, "pop %s", list);
+      return 0;
+    }
+
+    if(rn == REG_SP || !(regs & (1 << REG_SP)))
+      return -1;
+
+    insn->kind = INSN_PIVOT;
+    insn->regs = regs;
+    insn->base = rn;
+  }
+  else if(l && (regs & (1 << REG_SP)))
+    return -1;
+  else if(rn == REG_SP && wb)
+  {
+    if(l && pu == 1)
+    {
+      insn->stack = popcount(regs);
+      sprintf(insn->text, "pop%s %s", cond, list);
+      return 0;
+    }
+
+    if(!l && pu == 2)
+    {
+      insn->stack = -popcount(regs);
+      sprintf(insn->text, "push%s %s", cond, list);
+      return 0;
+    }
+
+    return -1;
+  }
+
+  sprintf(insn->text, "%s%s%s %s%s, %s", l ? "ldm" : "stm", modes[pu], cond,
+          reg_names[rn], wb ? "!" : "", list);
+  return 0;
+}
+
+// Decode one instruction; -1 if it is of no use in a gadget.
+static int
+decode(uint32_t w, insn_t *insn)
+{
+  const char *cond;
+
+  memset(insn, 0, sizeof(*insn));
+  insn->kind = INSN_BODY;
+  insn->cond = w >> 28;
+
+  if(insn->cond == 0xF)
+    return -1;
+  cond = cond_names[insn->cond];
+
+  // bx and blx
+  if((w & 0x0FFFFFD0) == 0x012FFF10)
+  {
+    int rm = w & 0xF;
+
+    if(rm == REG_PC)
+      return -1;
+    sprintf(insn->text, "%s%s %s", w & (1 << 5) ? "blx" : "bx", cond,
+            reg_names[rm]);
+    if(insn->cond == COND_AL)
+    {
+      insn->kind = INSN_BX;
+      insn->regs = 1 << rm;
+    }
+    return 0;
+  }
+
+  switch((w >> 25) & 7)
+  {
+    case 0:
+      if((w & 0x90) == 0x90)
+      {
+        int rd = (w >> 16) & 0xF, rn = (w >> 12) & 0xF, rs = (w >> 8) & 0xF;
+        int rm = w & 0xF;
+
+        if(w & 0x60)
+          return decode_extra(w, insn, cond);
+
+        // mul and mla
+        if((w & 0x0FC00000) != 0 || rd >= REG_SP || rm == REG_PC
+        || rs == REG_PC || (!(w & (1 << 21)) && rn != 0))
+          return -1;
+        if(w & (1 << 21))
+        {
+          if(rn == REG_PC)
+            return -1;
+          sprintf(insn->text, "mla%s%s %s, %s, %s, %s",
+                  w & (1 << 20) ? "s" : "", cond, reg_names[rd],
+                  reg_names[rm], reg_names[rs], reg_names[rn]);
+        }
+        else
+          sprintf(insn->text, "mul%s%s %s, %s, %s", w & (1 << 20) ? "s" : "",
+                  cond, reg_names[rd], reg_names[rm], reg_names[rs]);
+        return 0;
+      }
+      return decode_data(w, insn, cond);
+
+    case 1:
+      // movw and movt
+      if((w & 0x0FB00000) == 0x03000000)
+      {
+        int rd = (w >> 12) & 0xF;
+
+        if(rd >= REG_SP)
+          return -1;
+        sprintf(insn->text, "mov%s%s %s, #0x%x", w & (1 << 22) ? "t" : "w",
+                cond, reg_names[rd], ((w >> 4) & 0xF000) | (w & 0xFFF));
+        return 0;
+      }
+      if((w & 0x0FB00000) == 0x03200000)
+        return -1;
+      return decode_data(w, insn, cond);
+
+    case 2:
+    case 3:
+      return decode_transfer(w, insn, cond);
+
+    case 4:
+      return decode_block(w, insn, cond);
+
+    case 7:
+      if(w & (1 << 24))
+      {
+        sprintf(insn->text, "svc%s 0x%08x", cond, w & 0xFFFFFF);
+        return 0;
+      }
+
+      // mrc and mcr
+      if(w & (1 << 4))
+      {
+        int rt = (w >> 12) & 0xF;
+
+        if(rt == REG_PC || rt == REG_SP)
+          return -1;
+        sprintf(insn->text, "%s%s %d, %d, %s, cr%d, cr%d, {%d}",
+                w & (1 << 20) ? "mrc" : "mcr", cond, (w >> 8) & 0xF,
+                (w >> 21) & 7, reg_names[rt], (w >> 16) & 0xF, w & 0xF,
+                (w >> 5) & 7);
+        return 0;
+      }
+      return -1;
+
+    default:
+      // branches and coprocessor transfers
+      return -1;
+  }
+}
+
+// Text for comparing instructions: lower case, without '#' or spaces that
+// do not separate words, registers by number up to r12, numbers in hex
+// modulo 2^32, register lists in order and pre-UAL names of ldm and stm
+// modes and of pops and pushes mapped to what objdump prints.
+
+static int
+parse_reg(const char **p)
+{
+  static const char *aliases[][2] =
+  {
+    { "sl", "r10" }, { "fp", "r11" }, { "ip", "r12" }, { "sp", "r13" },
+    { "lr", "r14" }, { "pc", "r15" },
+  };
+  char   name[8];
+  size_t n = 0, i;
+
+  while(**p == ' ' || **p == '\t' || **p == '#')
+    ++*p;
+
+  while(isalnum((unsigned char)**p) && n < sizeof(name) - 1)
+    name[n++] = tolower((unsigned char)*(*p)++);
+  name[n] = 0;
+
+  for(i = 0; i < sizeof(aliases) / sizeof(*aliases); ++i)
+  {
+    if(strcmp(name, aliases[i][0]) == 0)
+      strcpy(name, aliases[i][1]);
+  }
+
+  if(name[0] == 'r' && isdigit((unsigned char)name[1]))
+  {
+    char *end;
+    long r = strtol(name + 1, &end, 10);
+
+    if(!*end && r < 16)
+      return r;
+  }
+
+  return -1;
+}
+
+// "{r4-r6, lr}" into a mask; -1 if it is not a register list
+static long
+parse_regs(const char **p)
+{
+  const char *s = *p + 1;
+  long       regs = 0;
+
+  for(;;)
+  {
+    int first = parse_reg(&s), last;
+
+    if(first < 0)
+      return -1;
+
+    last = first;
+    while(*s == ' ' || *s == '\t')
+      ++s;
+    if(*s == '-')
+    {
+      ++s;
+      last = parse_reg(&s);
+      if(last < first)
+        return -1;
+      while(*s == ' ' || *s == '\t')
+        ++s;
+    }
+
+    for(; first <= last; ++first)
+      regs |= 1 << first;
+
+    if(*s == '}')
+      break;
+    if(*s++ != ',')
+      return -1;
+  }
+
+  *p = s + 1;
+  return regs;
+}
+
+static const char *normal_regs[16] =
+{
+  "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+  "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc",
+};
+
+static void
+replace_prefix(char *s, size_t len, const char *with)
+{
+  memmove(s + strlen(with), s + len, strlen(s + len) + 1);
+  memcpy(s, with, strlen(with));
+}
+
+static int
+normalize(const char *in, char *out, size_t size)
+{
+  static const char *mnemonics[][2] =
+  {
+    { "ldmia", "ldm" }, { "ldmfd", "ldm" }, { "stmia", "stm" },
+    { "stmea", "stm" }, { "stmfd", "stmdb" }, { "ldmea", "ldmdb" },
+    { "ldmfa", "ldmda" }, { "stmed", "stmda" }, { "ldmed", "ldmib" },
+    { "stmfa", "stmib" }, { "swi", "svc" },
+  };
+  char   buf[TEXT_SIZE * 2], *o = buf, *end = buf + sizeof(buf) - 24;
+  int    word = 0, first = 1;
+  size_t i;
+
+  while(*in)
+  {
+    unsigned char c = *in;
+
+    if(o >= end)
+      return -1;
+
+    if(isspace(c) || c == '#')
+      ++in;
+    else if(isdigit(c) || (c == '-' && isdigit((unsigned char)in[1])))
+    {
+      char      *next;
+      long long v = strtoll(in, &next, 0);
+
+      o    += sprintf(o, "%s0x%x", word ? " " : "", (uint32_t)v);
+      in    = next;
+      word  = 1;
+      first = 0;
+    }
+    else if(isalnum(c) || c == '_')
+    {
+      const char *start = in;
+      char       tok[32];
+      size_t     n = 0;
+      int        r;
+
+      while((isalnum((unsigned char)*in) || *in == '_') && n < sizeof(tok) - 1)
+        tok[n++] = tolower((unsigned char)*in++);
+      tok[n] = 0;
+
+      if(word)
+        *o++ = ' ';
+
+      if(first)
+      {
+        for(i = 0; i < sizeof(mnemonics) / sizeof(*mnemonics); ++i)
+        {
+          if(strcmp(tok, mnemonics[i][0]) == 0)
+            strcpy(tok, mnemonics[i][1]);
+        }
+        o += sprintf(o, "%s", tok);
+      }
+      else if(tok[0] == 'p' && isdigit((unsigned char)tok[1])
+           && strspn(tok + 1, "0123456789") == n - 1)
+        o += sprintf(o, "0x%x", atoi(tok + 1));
+      else if(tok[0] == 'c' && tok[1] == 'r' && isdigit((unsigned char)tok[2]))
+        o += sprintf(o, "c%s", tok + 2);
+      else if((r = parse_reg(&start)) >= 0 && start == in)
+        o += sprintf(o, "%s", normal_regs[r]);
+      else
+        o += sprintf(o, "%s", tok);
+
+      word  = 1;
+      first = 0;
+    }
+    else if(c == '{')
+    {
+      const char *p = in;
+      long       regs = parse_regs(&p);
+      char       *next;
+
+      if(regs >= 0)
+      {
+        o += sprintf(o, "%s{", word ? " " : "");
+        for(i = 0; i < 16; ++i)
+        {
+          if(regs & (1 << i))
+            o += sprintf(o, "%s%s", o[-1] == '{' ? "" : ",", normal_regs[i]);
+        }
+        o   += sprintf(o, "}");
+        in   = p;
+        word = 0;
+        continue;
+      }
+
+      // mrc's {opc2}
+      p = in + 1;
+      while(*p == ' ' || *p == '#')
+        ++p;
+      strtol(p, &next, 0);
+      while(next != p && (*next == ' ' || *next == '\t'))
+        ++next;
+      if(next != p && *next == '}')
+      {
+        o   += sprintf(o, "%s0x%x", word ? " " : "",
+                       (uint32_t)strtol(p, NULL, 0));
+        in   = next + 1;
+        word = 1;
+        continue;
+      }
+
+      *o++ = *in++;
+      word = 0;
+    }
+    else
+    {
+      *o++ = *in++;
+      word = 0;
+    }
+  }
+  *o = 0;
+
+  // the forms objdump prints pops and pushes in
+  if(strncmp(buf, "ldm sp!,{", 9) == 0)
+    replace_prefix(buf, 8, "pop ");
+  else if(strncmp(buf, "stmdb sp!,{", 11) == 0)
+    replace_prefix(buf, 10, "push ");
+  else if(strncmp(buf, "ldr ", 4) == 0 || strncmp(buf, "str ", 4) == 0)
+  {
+    const char *tail = buf[0] == 'l' ? ",[sp],0x4" : ",[sp,0xfffffffc]!";
+    char       *comma = strchr(buf, ',');
+    char       reg[8];
+
+    if(comma && comma - buf - 4 < (int)sizeof(reg) && strcmp(comma, tail) == 0)
+    {
+      memcpy(reg, buf + 4, comma - buf - 4);
+      reg[comma - buf - 4] = 0;
+      sprintf(buf, "%s {%s}", buf[0] == 'l' ? "pop" : "push", reg);
+    }
+  }
+
+  if(strlen(buf) >= size)
+    return -1;
+  strcpy(out, buf);
+  return 0;
+}
+
+typedef struct
+{
+  gadget_t *gadgets;
+  size_t   count;
+  size_t   limit;
+} index_t;
+
+static int
+compare_gadget(const void *a, const void *b)
+{
+  const gadget_t *x = a, *y = b;
+  int            rc = strcmp(x->body, y->body);
+
+  if(rc != 0)
+    return rc;
+  if(x->cost != y->cost)
+    return x->cost < y->cost ? -1 : 1;
+  if(x->conditional != y->conditional)
+    return x->conditional - y->conditional;
+  rc = strcmp(x->ret_text, y->ret_text);
+  if(rc != 0)
+    return rc;
+  return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static int
+index_add(index_t *index, const gadget_t *gadget)
+{
+  if(index->count == index->limit)
+  {
+    gadget_t *grown;
+
+    index->limit = index->limit ? index->limit * 2 : 0x10000;
+    grown        = realloc(index->gadgets,
+                           index->limit * sizeof(*index->gadgets));
+    if(!grown)
+      return -1;
+    index->gadgets = grown;
+  }
+
+  index->gadgets[index->count++] = *gadget;
+  return 0;
+}
+
+static int
+index_build(index_t *index, const uint8_t *code, size_t words, uint32_t base,
+            int max_body)
+{
+  char   body[(TEXT_SIZE + 1) * 64], text[TEXT_SIZE];
+  size_t i;
+
+  for(i = 0; i < words; ++i)
+  {
+    insn_t   ret, insn;
+    gadget_t gadget;
+    size_t   start, n;
+    int      stack;
+
+    if(decode(get32(code + i * 4), &ret) != 0 || ret.kind == INSN_BODY)
+      continue;
+
+    if(normalize(ret.text, text, sizeof(text)) != 0)
+      continue;
+
+    memset(&gadget, 0, sizeof(gadget));
+    gadget.ret         = base + i * 4;
+    gadget.kind        = ret.kind;
+    gadget.regs        = ret.regs;
+    gadget.base        = ret.base;
+    gadget.conditional = ret.cond != COND_AL;
+    gadget.ret_text    = strdup(text);
+    if(!gadget.ret_text)
+      return -1;
+
+    body[0] = 0;
+    stack   = ret.stack;
+
+    // the return on its own, then with each instruction before it
+    for(start = i; ; --start)
+    {
+      gadget.addr = base + start * 4;
+      gadget.cost = stack;
+      gadget.body = strdup(body);
+      if(!gadget.body || index_add(index, &gadget) != 0)
+      {
+        free(gadget.body);
+        if(start == i)
+          free(gadget.ret_text);
+        return -1;
+      }
+
+      if(start == 0 || (int)(i - start) == max_body
+      || decode(get32(code + (start - 1) * 4), &insn) != 0
+      || insn.kind != INSN_BODY
+      || normalize(insn.text, text, sizeof(text)) != 0)
+        break;
+
+      // prepend it to the body
+      n = strlen(text);
+      if(body[0])
+      {
+        memmove(body + n + 1, body, strlen(body) + 1);
+        body[n] = ';';
+      }
+      else
+        body[n] = 0;
+      memcpy(body, text, n);
+      stack += insn.stack;
+    }
+  }
+
+  qsort(index->gadgets, index->count, sizeof(*index->gadgets), compare_gadget);
+  return 0;
+}
+
+static void
+print_gadget(FILE *out, const gadget_t *gadget, const uint8_t *code,
+             uint32_t base)
+{
+  uint32_t addr;
+
+  for(addr = gadget->addr; addr <= gadget->ret; addr += 4)
+  {
+    insn_t insn;
+
+    decode(get32(code + (addr - base)), &insn);
+    fprintf(out, "%s%s", addr == gadget->addr ? "" : " ; ", insn.text);
+  }
+}
+
+// the return a spec asks for
+typedef struct
+{
+  int      kind;
+  uint16_t regs;
+  int      base;
+  char     text[TEXT_SIZE];
+} want_t;
+
+static int
+ret_fits(const gadget_t *gadget, const want_t *want)
+{
+  if(gadget->kind != want->kind)
+    return 0;
+
+  switch(want->kind)
+  {
+    case INSN_POP:
+      return (gadget->regs & want->regs) == want->regs;
+
+    case INSN_PIVOT:
+      if(want->text[0])
+        return strcmp(gadget->ret_text, want->text) == 0;
+      return gadget->base == want->base;
+
+    default:
+      return strcmp(gadget->ret_text, want->text) == 0;
+  }
+}
+
+// Split a spec into the body it has to run and the return it asks for.
+static int
+parse_spec(const char *spec, char *body, size_t size, want_t *want)
+{
+  char   item[TEXT_SIZE * 2], last[TEXT_SIZE * 2];
+  size_t len = 0;
+
+  memset(want, 0, sizeof(*want));
+  want->kind = INSN_POP;
+  want->regs = 1 << REG_PC;
+  body[0]    = 0;
+  last[0]    = 0;
+
+  while(*spec)
+  {
+    const char *end = strchr(spec, ';');
+    size_t     n    = end ? (size_t)(end - spec) : strlen(spec);
+
+    if(n >= sizeof(item))
+      return -1;
+    memcpy(item, spec, n);
+    item[n] = 0;
+    spec   += end ? n + 1 : n;
+
+    if(normalize(item, item, sizeof(item)) != 0)
+      return -1;
+    if(!item[0])
+      continue;
+
+    if(last[0])
+    {
+      if(len + strlen(last) + 2 > size)
+        return -1;
+      len += sprintf(body + len, "%s%s", len ? ";" : "", last);
+    }
+    strcpy(last, item);
+  }
+
+  if(!last[0])
+    return -1;
+
+  if(strncmp(last, "pop {", 5) == 0)
+  {
+    const char *p = last + 4;
+    long       regs = parse_regs(&p);
+
+    if(regs < 0 || *p)
+      return -1;
+    want->regs |= regs;
+    return 0;
+  }
+
+  if(strncmp(last, "bx ", 3) == 0 || strncmp(last, "blx ", 4) == 0)
+  {
+    want->kind = INSN_BX;
+    strcpy(want->text, last);
+    return 0;
+  }
+
+  if(strncmp(last, "pivot ", 6) == 0)
+  {
+    const char *p = last + 6;
+
+    want->kind = INSN_PIVOT;
+    want->base = parse_reg(&p);
+    return want->base < 0 || *p ? -1 : 0;
+  }
+
+  if(strncmp(last, "ldm", 3) == 0 && strstr(last, "sp,") && strstr(last, "pc}"))
+  {
+    want->kind = INSN_PIVOT;
+    strcpy(want->text, last);
+    return 0;
+  }
+
+  // any pop {..., pc}
+  if(len + strlen(last) + 2 > size)
+    return -1;
+  sprintf(body + len, "%s%s", len ? ";" : "", last);
+  return 0;
+}
+
+static const gadget_t*
+index_find(const index_t *index, const char *body, const want_t *want)
+{
+  size_t lo = 0, hi = index->count;
+
+  while(lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if(strcmp(index->gadgets[mid].body, body) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  // cheapest first
+  for(; lo < index->count && strcmp(index->gadgets[lo].body, body) == 0; ++lo)
+  {
+    if(ret_fits(&index->gadgets[lo], want))
+      return &index->gadgets[lo];
+  }
+
+  return NULL;
+}
+
+static void
+list_gadgets(const index_t *index, const uint8_t *code, uint32_t base)
+{
+  size_t i, j;
+
+  for(i = 0; i < index->count; i = j)
+  {
+    const gadget_t *gadget = &index->gadgets[i];
+
+    for(j = i + 1; j < index->count
+               && strcmp(index->gadgets[j].body, gadget->body) == 0
+               && strcmp(index->gadgets[j].ret_text, gadget->ret_text) == 0;
+        ++j)
+      ;
+
+    printf("0x%08x  %2d  %5zu  ", gadget->addr, gadget->cost, j - i);
+    print_gadget(stdout, gadget, code, base);
+    printf("\n");
+  }
+}
+
+// look each spec up, and print what it found; the number not found
+static int
+find_specs(const index_t *index, const uint8_t *code, uint32_t base,
+           char **specs, int count)
+{
+  int i, named = 0, missing = 0;
+
+  for(i = 0; i < count; ++i)
+  {
+    const char *eq = strchr(specs[i], '=');
+
+    if(eq && eq > specs[i]
+    && strspn(specs[i], "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                        "0123456789_") == (size_t)(eq - specs[i]))
+      ++named;
+  }
+
+  if(named && named != count)
+  {
+    fprintf(stderr, "either all specs or none have to be named\n");
+    return count;
+  }
+
+  if(named)
+    printf("[\n");
+
+  for(i = 0; i < count; ++i)
+  {
+    const char     *spec = specs[i];
+    char           body[(TEXT_SIZE + 1) * 64];
+    want_t         want;
+    const gadget_t *gadget;
+    size_t         name_len = 0;
+
+    if(named)
+    {
+      name_len = strchr(spec, '=') - spec;
+      spec    += name_len + 1;
+    }
+
+    if(parse_spec(spec, body, sizeof(body), &want) != 0)
+    {
+      fprintf(stderr, "%s: bad spec\n", specs[i]);
+      ++missing;
+      continue;
+    }
+
+    gadget = index_find(index, body, &want);
+    if(!gadget)
+    {
+      fprintf(stderr, "%s: no gadget\n", specs[i]);
+      ++missing;
+      continue;
+    }
+
+    if(named)
+      printf("(\"%.*s\", \"0x%x\"), # ", (int)name_len, specs[i],
+             gadget->addr);
+    else
+      printf("0x%08x  %2d  ", gadget->addr, gadget->cost);
+    print_gadget(stdout, gadget, code, base);
+    printf("\n");
+  }
+
+  if(named)
+    printf("]\n");
+
+  if(missing)
+    fprintf(stderr, "%d of %d specs not found\n", missing, count);
+  return missing;
+}
+
+static void
+index_destroy(index_t *index)
+{
+  size_t i;
+
+  for(i = 0; i < index->count; ++i)
+  {
+    // the return's text is shared by the gadgets that end in it
+    if(index->gadgets[i].addr == index->gadgets[i].ret)
+      free(index->gadgets[i].ret_text);
+    free(index->gadgets[i].body);
+  }
+  free(index->gadgets);
+}
+
+int main(int argc, char *argv[])
+{
+  index_t  index = { 0 };
+  uint8_t  *code;
+  size_t   len;
+  uint32_t base;
+  int      argi = 1, max_body = DEFAULT_MAX_BODY, rc = EXIT_SUCCESS;
+  char     *end;
+
+  for(; argi < argc && strncmp(argv[argi], "--", 2) == 0; ++argi)
+  {
+    if(strncmp(argv[argi], "--max-body=", 11) == 0
+    && atoi(argv[argi] + 11) >= 0 && atoi(argv[argi] + 11) <= 16)
+      max_body = atoi(argv[argi] + 11);
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(argc - argi < 2)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  base = strtoul(argv[argi + 1], &end, 0);
+  if(*end || end == argv[argi + 1] || base % 4 != 0)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(read_file(argv[argi], &code, &len) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[argi], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if(index_build(&index, code, len / 4, base, max_body) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[argi], strerror(ENOMEM));
+    rc = EXIT_FAILURE;
+  }
+  else if(argc - argi == 2)
+    list_gadgets(&index, code, base);
+  else if(find_specs(&index, code, base, argv + argi + 2, argc - argi - 2) != 0)
+    rc = EXIT_FAILURE;
+
+  index_destroy(&index);
+  free(code);
+  return rc;
+}
@@ -0,0 +1,781 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Ports a ropDB from one home menu version to others: every entry of the
+// proto ropDB names an address in the proto code.bin and how many words
+// from there make up its pattern, and is found again in each target
+// code.bin by searching for that pattern.
+//
+// Entries are either
+//   ("NAME", addr, size)          the address of the pattern, or
+//   ("NAME", addr, size, offset)  the word offset words into the pattern
+// where size is a word count or a tuple of counts of words that are kept
+// and skipped in turn, so that (4, 1, 6) matches 4 words, any word, and 6
+// more words.
+//
+// Each target is indexed once by aligned word and by aligned pair of words,
+// and each pattern is looked up through whichever of its words or pairs is
+// rarest in that target. A pattern found more than once is reported and the
+// first match is used; one not found fails that target.
+
+#define MAX_SIZES 16
+
+typedef struct
+{
+  char     *name;
+  int      line;
+  uint32_t addr;
+  uint32_t sizes[MAX_SIZES];
+  size_t   num_sizes;
+  int      has_offset;
+  uint32_t offset;
+
+  // taken from the proto code.bin
+  uint32_t *pattern;
+  uint8_t  *concrete; // 0 where any word matches
+  size_t   len;
+} entry_t;
+
+typedef struct
+{
+  uint64_t pair;
+  uint32_t pos;
+} pair_t;
+
+typedef struct
+{
+  uint8_t  *data;
+  size_t   words;
+  uint64_t *by_word; // word << 32 | position, sorted
+  pair_t   *by_pair; // sorted by pair, then position
+} code_t;
+
+typedef struct
+{
+  const entry_t   *entries;
+  size_t          num_entries;
+  uint32_t        base;
+
+  char            **targets; // code.bin, output, code.bin, output, ...
+  size_t          num_targets;
+  size_t          next_target;
+  int             failed;
+  pthread_mutex_t lock;
+} port_job_t;
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options] proto_code.bin base proto_ropdb.txt "
+          "code.bin output.txt [code.bin output.txt ...]\n"
+          "  --threads=N  port N versions at a time (default: one per CPU)\n",
+          prog);
+}
+
+static uint32_t
+get32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int
+read_file(const char *name, uint8_t **data, size_t *len)
+{
+  FILE   *file = fopen(name, "rb");
+  size_t limit = 0, rc;
+
+  *data = NULL;
+  *len  = 0;
+
+  if(!file)
+    return -1;
+
+  do
+  {
+    if(*len == limit)
+    {
+      uint8_t *grown;
+
+      limit = limit ? limit * 2 : 0x100000;
+      grown = realloc(*data, limit + 1);
+      if(!grown)
+      {
+        errno = ENOMEM;
+        break;
+      }
+      *data = grown;
+    }
+
+    rc    = fread(*data + *len, 1, limit - *len, file);
+    *len += rc;
+  } while(rc > 0);
+
+  if(ferror(file) || !feof(file))
+  {
+    int err = errno;
+
+    fclose(file);
+    free(*data);
+    errno = err;
+    return -1;
+  }
+
+  fclose(file);
+  (*data)[*len] = 0;
+  return 0;
+}
+
+// The proto ropDB is a Python list literal; only what it needs is parsed.
+
+typedef struct
+{
+  const char *name;
+  const char *start;
+  const char *p;
+} parser_t;
+
+static int
+parser_line(const parser_t *parser)
+{
+  const char *p;
+  int        line = 1;
+
+  for(p = parser->start; p < parser->p; ++p)
+    line += *p == '\n';
+
+  return line;
+}
+
+static void
+skip_space(parser_t *parser)
+{
+  for(;;)
+  {
+    if(*parser->p == '#')
+    {
+      while(*parser->p && *parser->p != '\n')
+        ++parser->p;
+    }
+    else if(*parser->p == ' ' || *parser->p == '\t' || *parser->p == '\r'
+         || *parser->p == '\n')
+      ++parser->p;
+    else
+      break;
+  }
+}
+
+// skip c if it comes next
+static int
+accept(parser_t *parser, char c)
+{
+  skip_space(parser);
+  if(*parser->p != c)
+    return 0;
+
+  ++parser->p;
+  return 1;
+}
+
+static int
+expect(parser_t *parser, char c)
+{
+  if(accept(parser, c))
+    return 0;
+
+  fprintf(stderr, "%s:%d: expected '%c'\n", parser->name,
+          parser_line(parser), c);
+  return -1;
+}
+
+static int
+parse_int(parser_t *parser, uint32_t *value)
+{
+  char          *end;
+  unsigned long v;
+
+  skip_space(parser);
+  errno = 0;
+  v     = strtoul(parser->p, &end, 0);
+  if(end == parser->p || errno != 0 || v > UINT32_MAX)
+  {
+    fprintf(stderr, "%s:%d: expected a number\n", parser->name,
+            parser_line(parser));
+    return -1;
+  }
+
+  parser->p = end;
+  *value    = v;
+  return 0;
+}
+
+static int
+parse_string(parser_t *parser, char **value)
+{
+  const char *start;
+
+  if(expect(parser, '"') != 0)
+    return -1;
+
+  start = parser->p;
+  while(*parser->p && *parser->p != '"' && *parser->p != '\n')
+    ++parser->p;
+
+  if(*parser->p != '"')
+  {
+    fprintf(stderr, "%s:%d: unterminated string\n", parser->name,
+            parser_line(parser));
+    return -1;
+  }
+
+  *value = strndup(start, parser->p - start);
+  ++parser->p;
+  return *value ? 0 : -1;
+}
+
+// a count, or a tuple of them
+static int
+parse_sizes(parser_t *parser, entry_t *entry)
+{
+  if(!accept(parser, '('))
+  {
+    entry->num_sizes = 1;
+    return parse_int(parser, &entry->sizes[0]);
+  }
+
+  entry->num_sizes = 0;
+  do
+  {
+    if(entry->num_sizes > 0 && accept(parser, ')'))
+      return 0;
+
+    if(entry->num_sizes == MAX_SIZES)
+    {
+      fprintf(stderr, "%s:%d: more than %d sizes\n", parser->name,
+              parser_line(parser), MAX_SIZES);
+      return -1;
+    }
+
+    if(parse_int(parser, &entry->sizes[entry->num_sizes++]) != 0)
+      return -1;
+  } while(accept(parser, ','));
+
+  return expect(parser, ')');
+}
+
+static int
+parse_entry(parser_t *parser, entry_t *entry)
+{
+  memset(entry, 0, sizeof(*entry));
+  entry->line = parser_line(parser);
+
+  if(expect(parser, '(') != 0
+  || parse_string(parser, &entry->name) != 0
+  || expect(parser, ',') != 0
+  || parse_int(parser, &entry->addr) != 0
+  || expect(parser, ',') != 0
+  || parse_sizes(parser, entry) != 0)
+    return -1;
+
+  if(!accept(parser, ','))
+    return expect(parser, ')');
+  if(accept(parser, ')'))
+    return 0;
+
+  entry->has_offset = 1;
+  if(parse_int(parser, &entry->offset) != 0)
+    return -1;
+
+  accept(parser, ',');
+  return expect(parser, ')');
+}
+
+static entry_t*
+parse_ropdb(const char *name, const char *text, size_t *num_entries)
+{
+  parser_t parser = { name, text, text };
+  entry_t  *entries = NULL;
+  size_t   limit = 0;
+
+  *num_entries = 0;
+
+  if(expect(&parser, '[') != 0)
+    return NULL;
+
+  while(!accept(&parser, ']'))
+  {
+    if(*num_entries == limit)
+    {
+      entry_t *grown;
+
+      limit = limit ? limit * 2 : 64;
+      grown = realloc(entries, limit * sizeof(*entries));
+      if(!grown)
+        goto error;
+      entries = grown;
+    }
+
+    if(parse_entry(&parser, &entries[*num_entries]) != 0)
+    {
+      free(entries[*num_entries].name);
+      goto error;
+    }
+    ++*num_entries;
+
+    if(!accept(&parser, ','))
+    {
+      if(expect(&parser, ']') != 0)
+        goto error;
+      break;
+    }
+  }
+
+  return entries;
+
+error:
+  while(*num_entries > 0)
+    free(entries[--*num_entries].name);
+  free(entries);
+  return NULL;
+}
+
+// read the words of each entry's pattern out of the proto code.bin
+static int
+build_pattern(entry_t *entry, const uint8_t *code, size_t code_len,
+              uint32_t base)
+{
+  size_t i, j, len = 0, pos = 0;
+
+  for(i = 0; i < entry->num_sizes; ++i)
+    len += entry->sizes[i];
+
+  if(len == 0 || entry->sizes[0] == 0)
+  {
+    fprintf(stderr, "line %d: %s: empty pattern\n", entry->line, entry->name);
+    return -1;
+  }
+
+  if(entry->addr < base || (entry->addr - base) % 4 != 0
+  || (entry->addr - base) / 4 + len > code_len / 4)
+  {
+    fprintf(stderr, "line %d: %s: 0x%x is not in the proto code.bin\n",
+            entry->line, entry->name, entry->addr);
+    return -1;
+  }
+
+  entry->pattern  = calloc(len, sizeof(*entry->pattern));
+  entry->concrete = calloc(len, sizeof(*entry->concrete));
+  if(!entry->pattern || !entry->concrete)
+    return -1;
+
+  code += entry->addr - base;
+  for(i = 0; i < entry->num_sizes; ++i)
+  {
+    for(j = 0; j < entry->sizes[i]; ++j, ++pos)
+    {
+      entry->concrete[pos] = i % 2 == 0;
+      if(entry->concrete[pos])
+        entry->pattern[pos] = get32(code + pos * 4);
+    }
+  }
+
+  entry->len = len;
+  return 0;
+}
+
+static int
+compare_word(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static int
+compare_pair(const void *a, const void *b)
+{
+  const pair_t *x = a, *y = b;
+
+  if(x->pair != y->pair)
+    return x->pair < y->pair ? -1 : 1;
+  return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+static inline uint32_t
+code_word(const code_t *code, size_t pos)
+{
+  return get32(code->data + pos * 4);
+}
+
+static int
+code_index(code_t *code)
+{
+  size_t i;
+
+  code->by_word = malloc((code->words + 1) * sizeof(*code->by_word));
+  code->by_pair = malloc((code->words + 1) * sizeof(*code->by_pair));
+  if(!code->by_word || !code->by_pair)
+    return -1;
+
+  for(i = 0; i < code->words; ++i)
+  {
+    code->by_word[i] = (uint64_t)code_word(code, i) << 32 | i;
+    if(i + 1 < code->words)
+    {
+      code->by_pair[i].pair = (uint64_t)code_word(code, i) << 32
+                            | code_word(code, i + 1);
+      code->by_pair[i].pos  = i;
+    }
+  }
+
+  qsort(code->by_word, code->words, sizeof(*code->by_word), compare_word);
+  if(code->words > 1)
+    qsort(code->by_pair, code->words - 1, sizeof(*code->by_pair),
+          compare_pair);
+  return 0;
+}
+
+// first index in by_word whose word is at least word
+static size_t
+lower_word(const code_t *code, uint64_t word)
+{
+  size_t lo = 0, hi = code->words;
+
+  while(lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if(code->by_word[mid] >> 32 < word)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static size_t
+lower_pair(const code_t *code, uint64_t pair)
+{
+  size_t lo = 0, hi = code->words ? code->words - 1 : 0;
+
+  while(lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if(code->by_pair[mid].pair < pair)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static int
+pattern_at(const code_t *code, const entry_t *entry, size_t start)
+{
+  size_t i;
+
+  if(start + entry->len > code->words)
+    return 0;
+
+  for(i = 0; i < entry->len; ++i)
+  {
+    if(entry->concrete[i] && code_word(code, start + i) != entry->pattern[i])
+      return 0;
+  }
+
+  return 1;
+}
+
+// Find the first two matches of entry's pattern, as word positions; returns
+// how many there are, up to 2
+static int
+code_find(const code_t *code, const entry_t *entry, size_t found[2])
+{
+  size_t i, best_off = 0, best_lo = 0, best_count = SIZE_MAX;
+  int    best_pair = 0, n = 0;
+
+  // the rarest word or pair of words in the pattern
+  for(i = 0; i < entry->len; ++i)
+  {
+    size_t lo, hi;
+
+    if(!entry->concrete[i])
+      continue;
+
+    if(i + 1 < entry->len && entry->concrete[i + 1])
+    {
+      uint64_t pair = (uint64_t)entry->pattern[i] << 32 | entry->pattern[i + 1];
+
+      lo = lower_pair(code, pair);
+      hi = lower_pair(code, pair + 1);
+      if(pair == UINT64_MAX)
+        hi = code->words ? code->words - 1 : 0;
+
+      if(hi - lo < best_count)
+      {
+        best_count = hi - lo;
+        best_lo    = lo;
+        best_off   = i;
+        best_pair  = 1;
+      }
+    }
+
+    lo = lower_word(code, entry->pattern[i]);
+    hi = lower_word(code, (uint64_t)entry->pattern[i] + 1);
+    if(hi - lo < best_count)
+    {
+      best_count = hi - lo;
+      best_lo    = lo;
+      best_off   = i;
+      best_pair  = 0;
+    }
+  }
+
+  // occurrences come in order of position, and so do the matches
+  for(i = best_lo; i < best_lo + best_count && n < 2; ++i)
+  {
+    size_t pos = best_pair ? code->by_pair[i].pos
+                           : (size_t)(uint32_t)code->by_word[i];
+
+    if(pos >= best_off && pattern_at(code, entry, pos - best_off))
+      found[n++] = pos - best_off;
+  }
+
+  return n;
+}
+
+// port every entry to one target and write its ropDB
+static int
+port_target(const port_job_t *job, const char *code_name,
+            const char *out_name)
+{
+  code_t code = { 0 };
+  size_t len, i;
+  FILE   *out = NULL;
+  int    rc = -1, missing = 0, ambiguous = 0;
+  char   **values;
+
+  values = calloc(job->num_entries, sizeof(*values));
+  if(!values || read_file(code_name, &code.data, &len) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", code_name, strerror(errno));
+    goto done;
+  }
+
+  code.words = len / 4;
+  if(code_index(&code) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", code_name, strerror(ENOMEM));
+    goto done;
+  }
+
+  for(i = 0; i < job->num_entries; ++i)
+  {
+    const entry_t *entry = &job->entries[i];
+    size_t        found[2];
+    uint32_t      value;
+    int           n = code_find(&code, entry, found);
+
+    if(n == 0)
+    {
+      fprintf(stderr, "%s: %s: no match\n", code_name, entry->name);
+      ++missing;
+      continue;
+    }
+
+    if(n > 1)
+    {
+      fprintf(stderr, "%s: %s: ambiguous, matches at 0x%zx and 0x%zx\n",
+              code_name, entry->name, job->base + found[0] * 4,
+              job->base + found[1] * 4);
+      ++ambiguous;
+    }
+
+    if(!entry->has_offset)
+      value = job->base + found[0] * 4;
+    else if(found[0] + entry->offset < code.words)
+      value = code_word(&code, found[0] + entry->offset);
+    else
+    {
+      fprintf(stderr, "%s: %s: value past the end of the code\n", code_name,
+              entry->name);
+      ++missing;
+      continue;
+    }
+
+    values[i] = malloc(16);
+    if(!values[i])
+      goto done;
+    sprintf(values[i], "0x%x", value);
+  }
+
+  if(missing)
+  {
+    fprintf(stderr, "%s: %d of %zu entries not found\n", code_name, missing,
+            job->num_entries);
+    goto done;
+  }
+
+  out = fopen(out_name, "w");
+  if(!out)
+  {
+    fprintf(stderr, "%s: %s\n", out_name, strerror(errno));
+    goto done;
+  }
+
+  fprintf(out, "[\n");
+  for(i = 0; i < job->num_entries; ++i)
+    fprintf(out, "(\"%s\", \"%s\"),\n", job->entries[i].name, values[i]);
+  fprintf(out, "]\n");
+
+  if(fclose(out) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", out_name, strerror(errno));
+    goto done;
+  }
+
+  if(ambiguous)
+    fprintf(stderr, "%s: %d ambiguous entries\n", code_name, ambiguous);
+  rc = 0;
+
+done:
+  for(i = 0; values && i < job->num_entries; ++i)
+    free(values[i]);
+  free(values);
+  free(code.data);
+  free(code.by_word);
+  free(code.by_pair);
+  return rc;
+}
+
+static void*
+port_worker(void *arg)
+{
+  port_job_t *job = arg;
+
+  for(;;)
+  {
+    size_t target;
+    int    rc;
+
+    pthread_mutex_lock(&job->lock);
+    target = job->next_target++;
+    pthread_mutex_unlock(&job->lock);
+
+    if(target >= job->num_targets)
+      break;
+
+    rc = port_target(job, job->targets[target * 2],
+                     job->targets[target * 2 + 1]);
+    if(rc != 0)
+    {
+      pthread_mutex_lock(&job->lock);
+      job->failed = 1;
+      pthread_mutex_unlock(&job->lock);
+    }
+  }
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  port_job_t job;
+  pthread_t  *threads;
+  entry_t    *entries;
+  uint8_t    *proto, *text;
+  size_t     proto_len, text_len, num_entries, i;
+  long       num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int        argi = 1;
+  char       *end;
+
+  for(; argi < argc && strncmp(argv[argi], "--", 2) == 0; ++argi)
+  {
+    if(strncmp(argv[argi], "--threads=", 10) == 0
+    && atoi(argv[argi] + 10) > 0)
+      num_threads = atoi(argv[argi] + 10);
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(argc - argi < 5 || (argc - argi - 3) % 2 != 0)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  job.base = strtoul(argv[argi + 1], &end, 0);
+  if(*end || end == argv[argi + 1])
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(read_file(argv[argi], &proto, &proto_len) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[argi], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if(read_file(argv[argi + 2], &text, &text_len) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[argi + 2], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  entries = parse_ropdb(argv[argi + 2], (const char*)text, &num_entries);
+  if(!entries)
+    return EXIT_FAILURE;
+
+  for(i = 0; i < num_entries; ++i)
+  {
+    if(build_pattern(&entries[i], proto, proto_len, job.base) != 0)
+      return EXIT_FAILURE;
+  }
+
+  job.entries     = entries;
+  job.num_entries = num_entries;
+  job.targets     = argv + argi + 3;
+  job.num_targets = (argc - argi - 3) / 2;
+  job.next_target = 0;
+  job.failed      = 0;
+
+  if(num_threads < 1)
+    num_threads = 1;
+  if((size_t)num_threads > job.num_targets)
+    num_threads = job.num_targets;
+
+  threads = calloc(num_threads, sizeof(*threads));
+  if(!threads || pthread_mutex_init(&job.lock, NULL) != 0)
+  {
+    fprintf(stderr, "%s\n", strerror(ENOMEM));
+    return EXIT_FAILURE;
+  }
+
+  // the calling thread is one of the workers
+  for(i = 1; i < (size_t)num_threads; ++i)
+  {
+    if(pthread_create(&threads[i], NULL, port_worker, &job) != 0)
+      break;
+  }
+  num_threads = i;
+
+  port_worker(&job);
+
+  for(i = 1; i < (size_t)num_threads; ++i)
+    pthread_join(threads[i], NULL);
+
+  pthread_mutex_destroy(&job.lock);
+  return job.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
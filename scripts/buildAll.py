@@ -1,21 +1,63 @@
 import sys
 import os
+import time
+import shutil
+import threading
 import itertools
+import subprocess
 import buildVersion
 
 # 0 : firm, 1 : cn, 2 : spider, 3 : ro
 
+# Every configuration is built in a copy of the tree of its own under
+# --builddir, --jobs of them at a time, and its p/, q/ and r/ files are
+# collected into this tree's. Everything a configuration builds includes
+# build/constants.h, so what is shared is what is not built per
+# configuration: the host tools in compress/ and menu_ropbin_patcher/, built
+# here first, libctru, which is linked rather than copied, and the cache of
+# generated files.
+# --multimenu builds the configurations which only differ by menu version
+# together, as one MULTIMENU=1 build.
+
 firmVersions=["POST5", "N3DS"]
 
+# not copied into the configurations' trees
+SKIP=[".git", "build", "p", "q", "r", "qri", ".cache", "_gate_build"]
+# linked into them instead, as nothing writes to them
+SHARED=["libctru", "libctru-fpic"]
+OUTPUTS=["p", "q", "r"]
+
+def usage():
+	print("use : "+sys.argv[0]+" [--jobs=<n>] [--builddir=<dir>] [--multimenu] [--enableotherapp] [--enablerecovery]")
+	exit(1)
+
 extraparams=""
 extraparams+=" LOADROPBIN=1"
-for arg in sys.argv:
+jobs=None
+builddir="build_all"
+multimenu=False
+for arg in sys.argv[1:]:
 	# if(arg=="--enableloadropbin"):
 		# extraparams+=" LOADROPBIN=1"
 	if(arg=="--enableotherapp"):
 		extraparams+=" OTHERAPP=1"
-	if(arg=="--enablerecovery"):
+	elif(arg=="--enablerecovery"):
 		extraparams+=" RECOVERY=1"
+	elif(arg=="--multimenu"):
+		multimenu=True
+	elif(arg.startswith("--jobs=") and arg[7:].isdigit() and int(arg[7:])>0):
+		jobs=int(arg[7:])
+	elif(arg.startswith("--builddir=") and len(arg)>11):
+		builddir=arg[11:]
+	else:
+		usage()
+
+if jobs==None:
+	try:
+		jobs=len(os.sched_getaffinity(0))
+	except AttributeError:
+		import multiprocessing
+		jobs=multiprocessing.cpu_count()
 
 supportVersions = []
 for v_1, _ in buildVersion.MENU_VERSION_MAP.items():
@@ -31,8 +73,116 @@ for v_1, _ in buildVersion.MENU_VERSION_MAP.items():
 					continue
 				supportVersions.append(v)
 
-cnt=0
-for v in supportVersions:
-	os.system("make clean")
-	os.system("make FIRMVERSION="+str(v[0])+" REGION="+str(v[1])+" MSETVERSION="+str(v[2])+" ROVERSION="+str(v[3])+" MENUVERSION="+str(v[4])+extraparams)
-print(cnt)
+root=os.getcwd()
+builddir=os.path.abspath(builddir)
+cacheDir=os.path.abspath(os.environ.get("CACHE_DIR", ".cache"))
+
+def outName(v):
+	return "%s_%s_%s_%s" % (v[0], v[1], v[4], v[2])
+
+# the configurations each make builds
+if multimenu:
+	builds=[]
+	for v in supportVersions:
+		for b in builds:
+			if b[0][:4]==v[:4]:
+				b.append(v)
+				break
+		else:
+			builds.append([v])
+	builds=[tuple(b) for b in builds]
+else:
+	builds=[(v,) for v in supportVersions]
+
+def buildName(b):
+	if multimenu:
+		return "%s_%s_%s" % (b[0][0], b[0][1], b[0][2])
+	return outName(b[0])
+
+def makeTree(tree):
+	shutil.rmtree(tree, True)
+	skip=SKIP+SHARED+[os.path.relpath(builddir, root)]
+	os.makedirs(tree)
+	for name in os.listdir(root):
+		if name in skip:
+			continue
+		src=os.path.join(root, name)
+		if os.path.isdir(src) and not(os.path.islink(src)):
+			shutil.copytree(src, os.path.join(tree, name), True)
+		else:
+			shutil.copy2(src, os.path.join(tree, name))
+	for name in SHARED:
+		if os.path.exists(os.path.join(root, name)):
+			os.symlink(os.path.join(root, name), os.path.join(tree, name))
+
+def build(b, log):
+	tree=os.path.join(builddir, buildName(b))
+	makeTree(tree)
+	v=b[0]
+	params="FIRMVERSION="+str(v[0])+" REGION="+str(v[1])+" MSETVERSION="+str(v[2])+" ROVERSION="+str(v[3])+" MENUVERSION="+str(v[4])+" CACHE_DIR="+cacheDir+extraparams
+	if multimenu:
+		params+=" MULTIMENU=1 MENUVERSIONS=\""+" ".join(str(w[4]) for w in b)+"\""
+	for cmd in ["make clean", "make "+params]:
+		log.write("$ "+cmd+"\n")
+		log.flush()
+		rc=subprocess.call(cmd, shell=True, cwd=tree, stdout=log, stderr=subprocess.STDOUT)
+		if rc!=0:
+			return False
+	for d in OUTPUTS:
+		if not(os.path.isdir(os.path.join(tree, d))):
+			continue
+		for name in os.listdir(os.path.join(tree, d)):
+			shutil.copy2(os.path.join(tree, d, name), os.path.join(root, d, name))
+	return True
+
+lock=threading.Lock()
+pending=list(builds)
+results={}
+
+def worker():
+	while True:
+		with lock:
+			if len(pending)==0:
+				return
+			b=pending.pop(0)
+		start=time.time()
+		log=open(os.path.join(builddir, buildName(b)+".log"), "w")
+		try:
+			ok=build(b, log)
+		except (OSError, IOError, shutil.Error) as e:
+			log.write(str(e)+"\n")
+			ok=False
+		log.close()
+		elapsed=time.time()-start
+		with lock:
+			results[b]=(ok, elapsed)
+			print("%-32s %s %7.1fs (%d/%d)" % (buildName(b), "ok    " if ok else "FAILED", elapsed, len(results), len(builds)))
+			sys.stdout.flush()
+
+if not(os.path.isdir(builddir)):
+	os.makedirs(builddir)
+for d in OUTPUTS:
+	if not(os.path.isdir(d)):
+		os.makedirs(d)
+
+wallStart=time.time()
+
+# the host tools do not depend on the configuration
+for d in ["compress", "menu_ropbin_patcher"]:
+	if subprocess.call("cd "+d+" && make", shell=True)!=0:
+		exit(1)
+
+print("building %d configurations in %d builds, %d at a time, in %s" % (len(supportVersions), len(builds), jobs, builddir))
+threads=[threading.Thread(target=worker) for i in range(min(jobs, len(builds)))]
+for t in threads:
+	t.start()
+for t in threads:
+	t.join()
+
+wall=time.time()-wallStart
+failed=[b for b in builds if not(results[b][0])]
+total=sum(results[b][1] for b in builds)
+print("%d built, %d failed, in %.1fs (%.1fs of builds, %.1fx)" % (len(builds)-len(failed), len(failed), wall, total, total/wall if wall>0 else 0))
+for b in failed:
+	print("failed: "+buildName(b)+", see "+os.path.join(builddir, buildName(b)+".log"))
+exit(1 if len(failed)>0 else 0)
@@ -0,0 +1,205 @@
+import sys
+import os
+import json
+import shutil
+import hashlib
+import subprocess
+
+# Content-addressed cache for generated files. A step is keyed on its command
+# line and on the contents of its inputs, the tool that does the work being
+# one of them. When the key is in the cache the outputs are copied from there
+# (and left alone if they are already up to date) instead of running the
+# command.
+#
+# With --each, every input/output pair is a step of its own, keyed on that
+# input as well, and the pairs that are not in the cache are appended to a
+# single run of the command.
+#
+# Outputs that were changed by hand, or that came from other inputs than the
+# current ones, are reported, as are cache entries that do not hold what
+# their manifest says (those are dropped and rebuilt).
+
+FORMAT = "1"
+
+hashes = {}
+
+def hashFile(fn):
+	h = hashlib.sha256()
+	f = open(fn, "rb")
+	while True:
+		b = f.read(1 << 20)
+		if not b:
+			break
+		h.update(b)
+	f.close()
+	return h.hexdigest()
+
+def inputHash(fn):
+	if not(fn in hashes):
+		hashes[fn] = hashFile(fn)
+	return hashes[fn]
+
+def makeKey(command, inputs):
+	h = hashlib.sha256()
+	h.update(("cache " + FORMAT + "\0").encode())
+	for a in command:
+		h.update((a + "\0").encode())
+	for fn in inputs:
+		h.update((fn + "\0" + inputHash(fn) + "\0").encode())
+	return h.hexdigest()
+
+def makeDirs(d):
+	try:
+		os.makedirs(d)
+	except OSError:
+		if not(os.path.isdir(d)):
+			raise
+
+def entryPath(key):
+	return os.path.join(cacheDir, key[0:2], key)
+
+def recordPath(out):
+	name = hashlib.sha256(os.path.abspath(out).encode()).hexdigest()
+	return os.path.join(cacheDir, "outputs", name)
+
+def loadJson(fn):
+	try:
+		f = open(fn, "r")
+		d = json.load(f)
+		f.close()
+		return d
+	except (IOError, ValueError):
+		return None
+
+def saveJson(fn, d):
+	makeDirs(os.path.dirname(fn))
+	tmp = fn + ".%d" % os.getpid()
+	f = open(tmp, "w")
+	json.dump(d, f)
+	f.close()
+	os.rename(tmp, fn)
+
+# copy the outputs of key into place; False if key is not cached
+def fetch(key, outputs):
+	entry = entryPath(key)
+	manifest = loadJson(os.path.join(entry, "manifest"))
+	if manifest == None:
+		return False
+
+	stored = manifest.get("outputs", [])
+	ok = len(stored) == len(outputs)
+	for i in range(len(stored)):
+		fn = os.path.join(entry, str(i))
+		ok = ok and os.path.isfile(fn) and hashFile(fn) == stored[i]
+	if not(ok):
+		print("cache: entry " + key + " is corrupt, rebuilding")
+		shutil.rmtree(entry, True)
+		return False
+
+	for i in range(len(outputs)):
+		if not(os.path.isfile(outputs[i])) or hashFile(outputs[i]) != stored[i]:
+			shutil.copyfile(os.path.join(entry, str(i)), outputs[i])
+	return True
+
+def store(key, outputs):
+	entry = entryPath(key)
+	tmp = entry + ".%d" % os.getpid()
+	shutil.rmtree(tmp, True)
+	makeDirs(tmp)
+	stored = []
+	for i in range(len(outputs)):
+		shutil.copyfile(outputs[i], os.path.join(tmp, str(i)))
+		stored.append(hashFile(outputs[i]))
+	saveJson(os.path.join(tmp, "manifest"), {"outputs": stored})
+	try:
+		os.rename(tmp, entry)
+	except OSError:
+		# another build stored it first
+		shutil.rmtree(tmp, True)
+
+def checkStale(out, key, inputs):
+	record = loadJson(recordPath(out))
+	if record == None or not(os.path.isfile(out)):
+		return
+
+	if hashFile(out) != record["output"]:
+		print("cache: " + out + " was changed since it was generated")
+	elif record["key"] != key:
+		changed = [fn for fn in inputs if record["inputs"].get(fn) != inputHash(fn)]
+		if len(changed) == 0:
+			changed = ["command"]
+		print("cache: " + out + " is stale (" + ", ".join(changed) + " changed)")
+
+def saveRecord(out, key, inputs):
+	saveJson(recordPath(out), {
+		"path": out,
+		"key": key,
+		"inputs": dict((fn, inputHash(fn)) for fn in inputs),
+		"output": hashFile(out)})
+
+def usage():
+	print("use : " + sys.argv[0] + " [--dir <cache_dir>] --inputs <file> ... (--outputs <file> ... | --each <input> <output> ...) -- <command> ...")
+	exit(1)
+
+cacheDir = ".cache"
+inputs = []
+outputs = []
+pairs = []
+command = []
+
+section = None
+args = sys.argv[1:]
+while len(args) > 0:
+	a = args.pop(0)
+	if a == "--":
+		command = args
+		break
+	elif a == "--dir" and len(args) > 0:
+		cacheDir = args.pop(0)
+	elif a in ("--inputs", "--outputs", "--each"):
+		section = a
+	elif section == "--inputs":
+		inputs.append(a)
+	elif section == "--outputs":
+		outputs.append(a)
+	elif section == "--each":
+		pairs.append(a)
+	else:
+		usage()
+
+if len(command) == 0 or (len(outputs) == 0) == (len(pairs) == 0) or len(pairs) % 2 != 0:
+	usage()
+
+if len(outputs) > 0:
+	key = makeKey(command, inputs)
+	for out in outputs:
+		checkStale(out, key, inputs)
+
+	if not(fetch(key, outputs)):
+		rc = subprocess.call(command)
+		if rc != 0:
+			exit(rc)
+		store(key, outputs)
+
+	for out in outputs:
+		saveRecord(out, key, inputs)
+else:
+	steps = []
+	missing = []
+	for k in range(0, len(pairs), 2):
+		(fin, out) = (pairs[k], pairs[k + 1])
+		key = makeKey(command, inputs + [fin])
+		checkStale(out, key, inputs + [fin])
+		steps.append((fin, out, key))
+		if not(fetch(key, [out])):
+			missing.append((fin, out, key))
+
+	if len(missing) > 0:
+		rc = subprocess.call(command + sum([[fin, out] for (fin, out, key) in missing], []))
+		if rc != 0:
+			exit(rc)
+		for (fin, out, key) in missing:
+			store(key, [out])
+
+	for (fin, out, key) in steps:
+		saveRecord(out, key, inputs + [fin])
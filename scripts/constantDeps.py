@@ -0,0 +1,128 @@
+import sys
+import os
+import re
+
+# Dependencies on single constants rather than on all of build/constants.h,
+# so that changing one only rebuilds what uses it.
+#
+# stamps <constants.h> <dir>
+#   keeps a file per constant in dir, which is only written when what the
+#   constant stands for changes: its value, or that of a constant its value
+#   names
+# deps <dir> <file or directory> ...
+#   prints the stamps of the constants the files, or those in the
+#   directories, use, following their .include and #include "..." lines
+# fixdep <dir>
+#   filters the output of gcc -MM, replacing constants.h with the stamps of
+#   the constants that the other prerequisites use
+
+IDENTIFIER = re.compile(r"[A-Za-z_][A-Za-z0-9_]*")
+DEFINE = re.compile(r"^\s*#define\s+([A-Za-z_][A-Za-z0-9_]*)\s+(.*?)\s*$")
+INCLUDE = re.compile(r"^\s*(?:\.include|#\s*include)\s+\"([^\"]+)\"", re.M)
+
+def usage():
+	print("use : "+sys.argv[0]+" (stamps <constants.h> <dir> | deps <dir> <file or directory> ... | fixdep <dir>)")
+	exit(1)
+
+def writeIfChanged(fn, s):
+	try:
+		if open(fn, "r").read() == s:
+			return False
+	except IOError:
+		pass
+	open(fn, "w").write(s)
+	return True
+
+def readConstants(fn):
+	d = {}
+	for line in open(fn, "r"):
+		m = DEFINE.match(line)
+		if m:
+			d[m.group(1)] = m.group(2)
+	return d
+
+# a constant's value followed by those of the constants it names, in turn
+def signature(d, name):
+	seen = set([name])
+	todo = [name]
+	out = ""
+	while len(todo) > 0:
+		n = todo.pop(0)
+		out += n + " = " + d[n] + "\n"
+		for m in sorted(set(IDENTIFIER.findall(d[n]))):
+			if m in d and not(m in seen):
+				seen.add(m)
+				todo.append(m)
+	return out
+
+def makeStamps(header, stampDir):
+	d = readConstants(header)
+	if not(os.path.isdir(stampDir)):
+		os.makedirs(stampDir)
+	for name in d:
+		writeIfChanged(os.path.join(stampDir, name), signature(d, name))
+	for name in os.listdir(stampDir):
+		if not(name in d):
+			os.remove(os.path.join(stampDir, name))
+
+def isConstantsHeader(fn):
+	return os.path.basename(fn) in ("constants.h", "constants.s") and os.path.basename(os.path.dirname(os.path.abspath(fn))) == "build"
+
+# identifiers used in the files and in what they include
+def usedNames(files):
+	names = set()
+	done = set()
+	todo = list(files)
+	while len(todo) > 0:
+		fn = todo.pop()
+		if os.path.isdir(fn):
+			todo += [os.path.join(fn, n) for n in os.listdir(fn) if os.path.splitext(n)[1] in (".c", ".h", ".s")]
+			continue
+		if fn in done or isConstantsHeader(fn) or not(os.path.isfile(fn)):
+			continue
+		done.add(fn)
+		try:
+			s = open(fn, "r").read()
+		except (IOError, UnicodeDecodeError):
+			continue
+		names.update(IDENTIFIER.findall(s))
+		for inc in INCLUDE.findall(s):
+			todo.append(os.path.join(os.path.dirname(fn), inc))
+	return names
+
+def stampsFor(stampDir, files):
+	if not(os.path.isdir(stampDir)):
+		return []
+	known = set(os.listdir(stampDir))
+	return [os.path.join(stampDir, n) for n in sorted(usedNames(files) & known)]
+
+def fixdep(stampDir, text):
+	out = ""
+	for rule in text.replace("\\\n", " ").split("\n"):
+		if not(":" in rule):
+			out += rule + "\n" if rule.strip() else ""
+			continue
+		(target, prereqs) = rule.split(":", 1)
+		prereqs = prereqs.split()
+		if not(any(isConstantsHeader(p) for p in prereqs)):
+			out += rule + "\n"
+			continue
+		prereqs = [p for p in prereqs if not(isConstantsHeader(p))]
+		stamps = stampsFor(stampDir, prereqs)
+		out += target + ": " + " ".join(prereqs + stamps) + "\n"
+		# like -MP, so that a constant going away does not break the build
+		for s in stamps:
+			out += s + ":\n"
+	return out
+
+if len(sys.argv) < 3:
+	usage()
+
+if sys.argv[1] == "stamps" and len(sys.argv) == 4:
+	makeStamps(sys.argv[2], sys.argv[3])
+elif sys.argv[1] == "deps":
+	print(" ".join(stampsFor(sys.argv[2], sys.argv[3:])))
+elif sys.argv[1] == "fixdep" and len(sys.argv) == 3:
+	sys.stdout.write(fixdep(sys.argv[2], sys.stdin.read()))
+else:
+	usage()
@@ -0,0 +1,163 @@
+import sys
+import os
+import ast
+import mmap
+import struct
+
+# Every firmware, CN, region and menu version's constants in one file, built
+# from the constants.txt and *_ropdb.txt lists so that nothing has to parse
+# those again. All numbers are little-endian u32s and all offsets are from
+# the start of the file:
+#
+#   header     "CDB1", section count, section table offset, entry count,
+#              entry table offset, order table offset, string table offset,
+#              string table size
+#   sections   (name offset, name length, first entry, entry count), sorted
+#              by name
+#   entries    (name offset, name length, value offset, value length), each
+#              section's in the order of its list
+#   order      for each section, the indices of its entries sorted by name
+#   strings    every name and value once, each followed by a 0 byte
+#
+# Sections are named after where their list came from: "firm/N3DS",
+# "cn/WEST", "region/E", "menu/17415" and so on. Looking a constant up is a
+# binary search through the sections and one through the section's order.
+
+MAGIC = b"CDB1"
+HEADER = struct.Struct("<4s7I")
+RECORD = struct.Struct("<4I")
+
+def readList(fn):
+	s = open(fn, "r").read()
+	if len(s.strip()) == 0:
+		return []
+	l = ast.literal_eval(s)
+	for k in l:
+		if len(k) != 2:
+			raise ValueError(fn + ": " + repr(k) + " is not a (name, value) pair")
+	return [(str(k[0]), str(k[1])) for k in l]
+
+def writeDb(fn, sections):
+	strings = bytearray()
+	offsets = {}
+
+	def addString(s):
+		b = s.encode()
+		if not(b in offsets):
+			offsets[b] = len(strings)
+			strings.extend(b + b"\0")
+		return (offsets[b], len(b))
+
+	names = sorted(sections.keys(), key=lambda n: n.encode())
+	sectionTable = bytearray()
+	entryTable = bytearray()
+	orderTable = bytearray()
+	count = 0
+	for name in names:
+		entries = sections[name]
+		sectionTable += RECORD.pack(*(addString(name) + (count, len(entries))))
+		for (k, v) in entries:
+			entryTable += RECORD.pack(*(addString(k) + addString(v)))
+		# stable, so that of several equal names the last one stays last
+		order = sorted(range(len(entries)), key=lambda i: entries[i][0].encode())
+		for i in order:
+			orderTable += struct.pack("<I", count + i)
+		count += len(entries)
+
+	while len(strings) % 4 != 0:
+		strings.append(0)
+
+	sectionsOffset = HEADER.size
+	entriesOffset = sectionsOffset + len(sectionTable)
+	orderOffset = entriesOffset + len(entryTable)
+	stringsOffset = orderOffset + len(orderTable)
+
+	tmp = fn + ".%d" % os.getpid()
+	f = open(tmp, "wb")
+	f.write(HEADER.pack(MAGIC, len(names), sectionsOffset, count, entriesOffset, orderOffset, stringsOffset, len(strings)))
+	f.write(sectionTable)
+	f.write(entryTable)
+	f.write(orderTable)
+	f.write(strings)
+	f.close()
+	os.rename(tmp, fn)
+
+class ConstantsDb:
+	def __init__(self, fn):
+		f = open(fn, "rb")
+		self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+		f.close()
+		(magic, self.numSections, self.sectionsOffset, self.numEntries, self.entriesOffset, self.orderOffset, self.stringsOffset, self.stringsSize) = HEADER.unpack_from(self.data, 0)
+		if magic != MAGIC:
+			raise ValueError(fn + " is not a constants database")
+
+	def string(self, offset, length):
+		start = self.stringsOffset + offset
+		return self.data[start:start + length]
+
+	def section(self, i):
+		return RECORD.unpack_from(self.data, self.sectionsOffset + i * RECORD.size)
+
+	def entry(self, i):
+		(k, kl, v, vl) = RECORD.unpack_from(self.data, self.entriesOffset + i * RECORD.size)
+		return (self.string(k, kl), self.string(v, vl))
+
+	def findSection(self, name):
+		b = name.encode()
+		(lo, hi) = (0, self.numSections)
+		while lo < hi:
+			mid = (lo + hi) // 2
+			s = self.section(mid)
+			n = self.string(s[0], s[1])
+			if n == b:
+				return s
+			if n < b:
+				lo = mid + 1
+			else:
+				hi = mid
+		return None
+
+	def sections(self):
+		return [self.string(s[0], s[1]).decode() for s in map(self.section, range(self.numSections))]
+
+	# the section's (name, value) pairs in the order of its list
+	def entries(self, name):
+		s = self.findSection(name)
+		if s == None:
+			raise KeyError(name)
+		return [tuple(x.decode() for x in self.entry(i)) for i in range(s[2], s[2] + s[3])]
+
+	def lookup(self, name, key):
+		s = self.findSection(name)
+		if s == None:
+			return None
+		b = key.encode()
+		(lo, hi) = (0, s[3])
+		# the last of the entries named key
+		while lo < hi:
+			mid = (lo + hi) // 2
+			(i,) = struct.unpack_from("<I", self.data, self.orderOffset + (s[2] + mid) * 4)
+			if self.entry(i)[0] <= b:
+				lo = mid + 1
+			else:
+				hi = mid
+		if lo == 0:
+			return None
+		(i,) = struct.unpack_from("<I", self.data, self.orderOffset + (s[2] + lo - 1) * 4)
+		(k, v) = self.entry(i)
+		return v.decode() if k == b else None
+
+if __name__ == "__main__":
+	if len(sys.argv) < 3:
+		print("use : " + sys.argv[0] + " <output.db> <section>=<list_file> ...")
+		exit(1)
+
+	sections = {}
+	for a in sys.argv[2:]:
+		(name, eq, fn) = a.partition("=")
+		if eq == "" or name in sections:
+			print("use : " + sys.argv[0] + " <output.db> <section>=<list_file> ...")
+			exit(1)
+		sections[name] = readList(fn)
+
+	writeDb(sys.argv[1], sections)
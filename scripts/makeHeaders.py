@@ -1,6 +1,9 @@
 from datetime import datetime
 import sys
+import os
 import ast
+import constantsDb
+import menuSlots
 
 def outputConstantsH(d):
 	out=""
@@ -23,8 +26,33 @@ def outputConstantsPY(d):
 		out+=(k[0]+" = ("+str(k[1])+")")+"\n"
 	return out
 
+# rewriting an unchanged file would make everything that includes it rebuild
+def writeIfChanged(fn, s):
+	try:
+		if open(fn,"r").read()==s:
+			return
+	except IOError:
+		pass
+	open(fn,"w").write(s)
+
+# BUILDTIME comes from --epoch or SOURCE_DATE_EPOCH when either is given, so
+# that the same sources give the same headers
+epoch=os.environ.get("SOURCE_DATE_EPOCH")
+for arg in sys.argv[1:]:
+	if arg.startswith("--epoch="):
+		epoch=arg[8:]
+		sys.argv.remove(arg)
+		break
+buildTime=datetime.utcfromtimestamp(int(epoch)) if epoch else datetime.now()
+
+# --slots leaves the menu constants which differ between menu versions as
+# slots, see menuSlots.py
+withSlots="--slots" in sys.argv
+if withSlots:
+	sys.argv.remove("--slots")
+
 if len(sys.argv)<8:
-	print("use : "+sys.argv[0]+" <firmver> <cnver> <msetver> <rover> <menuver> <region> <outname> <extensionless_output_name> <input_file1> <input_file2> ...")
+	print("use : "+sys.argv[0]+" [--epoch=<seconds>] [--slots] <firmver> <cnver> <msetver> <rover> <menuver> <region> <outname> <extensionless_output_name> (<input_file1> <input_file2> ... | --db <constants.db> <section1> <section2> ...)")
 	exit()
 
 # l=[("_SPIDER_VERSION", sys.argv[3]),
@@ -41,15 +69,30 @@ l+=[("FIRM_VERSION", "\""+sys.argv[1]+"\""),
 	("CN_NINJHAX_URL", "\"http://smealum.github.io/ninjhax2/JL1Xf2KFVm/beta/p/\""),
 	("OUTNAME", "\""+sys.argv[7]+"\"")]
 l+=[("CN_%s" % sys.argv[2], "1")]
-l+=[("BUILDTIME", "\""+datetime.now().strftime("%Y-%m-%d %H:%M:%S")+"\"")]
+l+=[("BUILDTIME", "\""+buildTime.strftime("%Y-%m-%d %H:%M:%S")+"\"")]
 l+=[("HAX_NAME_VERSION", "\"*hax 2.8 beta\"")]
 l+=[("HB_NUM_HANDLES", "16")]
 
-for fn in sys.argv[9:]:
-	s=open(fn,"r").read()
-	if len(s)>0:
-		l+=(ast.literal_eval(s))
+# the slots' bases are armips -equ values in constants.s
+slotBases=[]
+if len(sys.argv)>10 and sys.argv[9]=="--db":
+	db=constantsDb.ConstantsDb(sys.argv[10])
+	slots=menuSlots.slotNames(db) if withSlots else []
+	for section in sys.argv[11:]:
+		e=db.entries(section)
+		if withSlots and section.startswith("menu/"):
+			e=[k for k in e if not(k[0] in slots)]+menuSlots.slotConstants(slots)
+			slotBases=menuSlots.baseConstants()
+		l+=e
+elif withSlots:
+	print("--slots needs --db")
+	exit(1)
+else:
+	for fn in sys.argv[9:]:
+		s=open(fn,"r").read()
+		if len(s)>0:
+			l+=(ast.literal_eval(s))
 
-open(sys.argv[8]+".h","w").write(outputConstantsH(l))
-open(sys.argv[8]+".s","w").write(outputConstantsS(l))
-open(sys.argv[8]+".py","w").write(outputConstantsPY(l))
+writeIfChanged(sys.argv[8]+".h",outputConstantsH(slotBases+l))
+writeIfChanged(sys.argv[8]+".s",outputConstantsS(l))
+writeIfChanged(sys.argv[8]+".py",outputConstantsPY(slotBases+l))
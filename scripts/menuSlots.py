@@ -0,0 +1,169 @@
+import sys
+import struct
+import constantsDb
+
+# Builds for several menu versions at once (MULTIMENU=1). The menu payloads
+# only differ between menu versions by the constants of their ropDBs, so
+# makeHeaders.py --slots gives every such constant a slot instead of a value,
+#
+#   (MENU_SLOT_BASE + MENU_SLOT_STRIDE * slot + 0x8000)
+#
+# and each payload is assembled twice, with two different bases and strides.
+# The words which differ between the two are where the slots are used, which
+# relocs writes down as (offset, slot | addend << 16) pairs after a count.
+# Using a slot any other way than plus or minus a small offset makes it fail,
+# rather than leave a value in the payload which no version's can replace.
+#
+# The relocations of the three menu payloads go into cn_secondary_payload,
+# behind a row of slot values which fill writes a menu version's values into;
+# the payload applies them when it unpacks the menu payloads. patch applies
+# them on the host instead, for the ropbin files.
+#
+# blob layout, all little-endian u32s:
+#   "MSLT", slot count, slot values, then for menu_payload_regionfree,
+#   menu_payload_loadropbin and menu_ropbin, relocation count and relocations
+
+MAGIC = b"MSLT"
+# what menu_payload assembles with, as armips -equ values; the first is also
+# what constants.h and constants.py get
+BASES = ((0xC5000000, 0x10000), (0xC6000000, 0x20000))
+BIAS = 0x8000
+NUM_PAYLOADS = 3
+
+def usage():
+	print("use : "+sys.argv[0]+" relocs <constants.db> <a.bin> <b.bin> <out.slots>")
+	print("      "+sys.argv[0]+" blob <constants.db> <out.bin> (<payload.slots> | -) ...")
+	print("      "+sys.argv[0]+" fill <constants.db> <menu section> <in.bin> <out.bin>")
+	print("      "+sys.argv[0]+" patch <constants.db> <menu section> <in.bin> <out.bin> <payload.slots> [<offset> ...]")
+	exit(1)
+
+def menuSections(db):
+	return [s for s in db.sections() if s.startswith("menu/")]
+
+# the menu constants which are not the same for every menu version
+def slotNames(db):
+	values = [dict(db.entries(s)) for s in menuSections(db)]
+	names = set()
+	for d in values:
+		names.update(d.keys())
+	return sorted(n for n in names if len(set(d.get(n) for d in values)) > 1)
+
+def slotConstants(names):
+	return [(n, "(MENU_SLOT_BASE+MENU_SLOT_STRIDE*%d+0x%X)" % (i, BIAS)) for (i, n) in enumerate(names)]
+
+def baseConstants():
+	return [("MENU_SLOT_BASE", "0x%08X" % BASES[0][0]), ("MENU_SLOT_STRIDE", "0x%X" % BASES[0][1])]
+
+def parseValue(s):
+	s = s.strip()
+	while s.startswith("(") and s.endswith(")"):
+		s = s[1:-1].strip()
+	return int(s, 0) & 0xFFFFFFFF
+
+# a menu version's slot values, None where its ropDB does not have one
+def slotRow(db, section, names):
+	d = dict(db.entries(section))
+	return [parseValue(d[n]) if n in d else None for n in names]
+
+def slotWord(base, slot, addend):
+	return (base[0] + base[1] * slot + BIAS + addend) & 0xFFFFFFFF
+
+def decode(w, base, numSlots):
+	d = (w - base[0]) & 0xFFFFFFFF
+	slot = d // base[1]
+	if slot >= numSlots:
+		return None
+	return (slot, d % base[1] - BIAS)
+
+def findRelocs(a, b, numSlots, name):
+	if len(a) != len(b):
+		raise ValueError(name + ": its size depends on menu constants")
+	relocs = []
+	for i in range(0, len(a) & ~3, 4):
+		(wa,) = struct.unpack_from("<I", a, i)
+		(wb,) = struct.unpack_from("<I", b, i)
+		if wa == wb:
+			continue
+		r = decode(wa, BASES[0], numSlots)
+		if r == None or slotWord(BASES[1], r[0], r[1]) != wb:
+			raise ValueError(name + ": menu constants used at 0x%X in a way slots cannot express" % i)
+		relocs.append((i,) + r)
+	if a[len(a) & ~3:] != b[len(b) & ~3:]:
+		raise ValueError(name + ": menu constants used in its last bytes")
+	return relocs
+
+def packRelocs(relocs):
+	out = struct.pack("<I", len(relocs))
+	for (offset, slot, addend) in relocs:
+		out += struct.pack("<II", offset, slot | ((addend & 0xFFFF) << 16))
+	return out
+
+def unpackRelocs(data, offset = 0):
+	(n,) = struct.unpack_from("<I", data, offset)
+	relocs = []
+	for i in range(n):
+		(o, info) = struct.unpack_from("<II", data, offset + 4 + i * 8)
+		addend = info >> 16
+		relocs.append((o, info & 0xFFFF, addend - 0x10000 if addend & 0x8000 else addend))
+	return relocs
+
+def resolve(row, relocs, section):
+	for (offset, slot, addend) in relocs:
+		if row[slot] == None:
+			raise ValueError(section + " has no value for slot %d, used at 0x%X" % (slot, offset))
+
+def findBlob(data, numSlots):
+	header = MAGIC + struct.pack("<I", numSlots)
+	found = [i for i in range(0, len(data) - 7, 4) if data[i:i + 8] == header]
+	if len(found) != 1:
+		raise ValueError("%d menu slot tables found" % len(found))
+	return found[0]
+
+if __name__ == "__main__":
+	if len(sys.argv) < 4:
+		usage()
+
+	db = constantsDb.ConstantsDb(sys.argv[2])
+	names = slotNames(db)
+
+	try:
+		if sys.argv[1] == "relocs" and len(sys.argv) == 6:
+			a = open(sys.argv[3], "rb").read()
+			b = open(sys.argv[4], "rb").read()
+			open(sys.argv[5], "wb").write(packRelocs(findRelocs(a, b, len(names), sys.argv[3])))
+		elif sys.argv[1] == "blob" and len(sys.argv) == 4 + NUM_PAYLOADS:
+			out = MAGIC + struct.pack("<I", len(names)) + b"\0" * 4 * len(names)
+			for fn in sys.argv[4:]:
+				out += packRelocs([]) if fn == "-" else open(fn, "rb").read()
+			open(sys.argv[3], "wb").write(out)
+		elif sys.argv[1] == "fill" and len(sys.argv) == 6:
+			row = slotRow(db, sys.argv[3], names)
+			data = bytearray(open(sys.argv[4], "rb").read())
+			start = findBlob(data, len(names))
+			offset = start + 8 + 4 * len(names)
+			for i in range(NUM_PAYLOADS):
+				relocs = unpackRelocs(data, offset)
+				resolve(row, relocs, sys.argv[3])
+				offset += 4 + 8 * len(relocs)
+			struct.pack_into("<%dI" % len(names), data, start + 8, *[v or 0 for v in row])
+			open(sys.argv[5], "wb").write(data)
+		elif sys.argv[1] == "patch" and len(sys.argv) >= 7:
+			row = slotRow(db, sys.argv[3], names)
+			data = bytearray(open(sys.argv[4], "rb").read())
+			relocs = unpackRelocs(open(sys.argv[6], "rb").read())
+			resolve(row, relocs, sys.argv[3])
+			for base in [int(o, 0) for o in sys.argv[7:]] or [0]:
+				for (offset, slot, addend) in relocs:
+					# words the payload's own patching has replaced since stay
+					(w,) = struct.unpack_from("<I", data, base + offset)
+					if w == slotWord(BASES[0], slot, addend):
+						struct.pack_into("<I", data, base + offset, (row[slot] + addend) & 0xFFFFFFFF)
+			open(sys.argv[5], "wb").write(data)
+		else:
+			usage()
+	except ValueError as e:
+		print(sys.argv[0] + ": " + str(e))
+		exit(1)
+	except KeyError as e:
+		print(sys.argv[0] + ": no constants for " + str(e.args[0]))
+		exit(1)
@@ -0,0 +1,111 @@
+import sys
+import struct
+
+# Where the menu payloads' placeholder words are, so that what patches them
+# does not have to search for them. A table is a count followed by that many
+# (word index << 16 | kind) words, sorted by index.
+#
+# The payloads get their placeholders from ROP_ALIAS_BASE and ROP_FILLER,
+# and are assembled twice, with BASES[0] and BASES[1] for them; the words
+# which differ between the two are the placeholders, like menuSlots.py finds
+# its slots. Words which are the same in both only look like placeholders,
+# but for the ones incbin'd from app_code and app_bootloader, which armips
+# does not build: see ropbin.
+#
+# ropbin <menu_ropbin.bin> <other.bin>
+#   ROP_ALIAS_BASE + 0x1 to 0xA, as patchPayload in app_targets.h fills them
+#   in, the kind being the low half. app_bootloader has some of its own as
+#   C constants, so words of 0xBABE0001 to 0xBABE000A in both are taken as
+#   well, as the old search in patchPayload did. The ropbin is padded to the
+#   0x8000 bytes that get copied around, with the table at its end and, in
+#   its last two words, the table's offset and "BRLC", since patchPayload
+#   runs on copies made in home menu where nothing else could go.
+# payload <menu_payload.bin> <other.bin> <out_relocs.bin>
+#   for inject_payload in cn_secondary_payload: words relative to
+#   ROP_ALIAS_BASE are kind 0, relative to where the payload goes, ROP_FILLER
+#   words are kind 1, what was there before is kept
+
+# ROP_ALIAS_BASE and ROP_FILLER, as menu_payload/Makefile assembles with
+# them; the payloads end up with the first
+BASES = ((0xBABE0000, 0xDEADCAFE), (0xC0DE0000, 0xFEEDF00D))
+ROPBIN_SIZE = 0x8000
+MAGIC = 0x434C5242
+# what 0xBABE0006's memorymap_t can cover, an alias there would be overwritten
+MEMORYMAP_SIZE = 0x100
+
+def usage():
+	print("use : "+sys.argv[0]+" (ropbin <menu_ropbin.bin> <other.bin> | payload <menu_payload.bin> <other.bin> <out_relocs.bin>)")
+	exit(1)
+
+def words(data):
+	return struct.unpack_from("<%dI" % (len(data) // 4), data)
+
+# (word index, word in a, kind), kind being what the placeholder is relative
+# to, an index into BASES' rows, or None where a and b are the same
+def placeholders(a, b, name):
+	if len(a) != len(b):
+		raise ValueError(name + ": its size depends on ROP_ALIAS_BASE or ROP_FILLER")
+	if a[len(a) & ~3:] != b[len(b) & ~3:]:
+		raise ValueError(name + ": ROP_ALIAS_BASE or ROP_FILLER used in its last bytes")
+	found = []
+	for (i, (wa, wb)) in enumerate(zip(words(a), words(b))):
+		if wa == wb:
+			found.append((i, wa, None))
+			continue
+		kinds = [k for k in range(2) if (wa - BASES[0][k]) & 0xFFFFFFFF == (wb - BASES[1][k]) & 0xFFFFFFFF]
+		if len(kinds) != 1:
+			raise ValueError(name + ": ROP_ALIAS_BASE or ROP_FILLER used at 0x%X in a way a table cannot express" % (i * 4))
+		found.append((i, wa, kinds[0]))
+	return found
+
+def ropbinRelocs(a, b, name):
+	relocs = []
+	for (i, w, kind) in placeholders(a, b, name):
+		if kind == None:
+			# incbin'd, or data which only looks like a placeholder
+			if w >> 16 == BASES[0][0] >> 16 and 0x1 <= w & 0xFFFF <= 0xA:
+				relocs.append((i, w & 0xFFFF))
+		elif kind == 0 and 0x1 <= w - BASES[0][0] <= 0xA:
+			relocs.append((i, w - BASES[0][0]))
+		else:
+			raise ValueError(name + ": 0x%08X at 0x%X is no ropbin placeholder" % (w, i * 4))
+	for (i, k) in relocs:
+		if k == 0x6 and any(i < j < i + MEMORYMAP_SIZE // 4 for (j, _) in relocs):
+			raise ValueError("alias at 0x%X would be under the memorymap at 0x%X" % ([j for (j, _) in relocs if i < j][0] * 4, i * 4))
+	return relocs
+
+def payloadRelocs(a, b, name):
+	relocs = []
+	for (i, w, kind) in placeholders(a, b, name):
+		if kind == 1 and w != BASES[0][1]:
+			raise ValueError(name + ": ROP_FILLER used at 0x%X other than as is" % (i * 4))
+		if kind != None:
+			relocs.append((i, kind))
+	return relocs
+
+def packTable(relocs):
+	return struct.pack("<%dI" % (1 + len(relocs)), len(relocs), *[(i << 16) | k for (i, k) in relocs])
+
+if len(sys.argv) < 4:
+	usage()
+
+try:
+	if sys.argv[1] == "ropbin" and len(sys.argv) == 4:
+		data = open(sys.argv[2], "rb").read()
+		if len(data) >= 8 and struct.unpack_from("<I", data, len(data) - 4)[0] == MAGIC:
+			raise ValueError(sys.argv[2] + " already has its table")
+		table = packTable(ropbinRelocs(data, open(sys.argv[3], "rb").read(), sys.argv[2]))
+		offset = ROPBIN_SIZE - 8 - len(table)
+		if len(data) > offset:
+			raise ValueError(sys.argv[2] + " is 0x%X bytes, its table only leaves room for 0x%X" % (len(data), offset))
+		data += b"\0" * (offset - len(data)) + table + struct.pack("<II", offset, MAGIC)
+		open(sys.argv[2], "wb").write(data)
+	elif sys.argv[1] == "payload" and len(sys.argv) == 5:
+		data = open(sys.argv[2], "rb").read()
+		relocs = payloadRelocs(data, open(sys.argv[3], "rb").read(), sys.argv[2])
+		open(sys.argv[4], "wb").write(packTable(relocs))
+	else:
+		usage()
+except ValueError as e:
+	print(sys.argv[0] + ": " + str(e))
+	exit(1)